@@ -3,12 +3,14 @@
 
 #include <algorithm>
 #include <cmath>
-#include <iostream>
 #include <numeric>
 #include <vector>
 
 #include <nlopt.hpp>
 
+// Thread safety: the circle fits are pure functions of their input points and
+// may be called concurrently.
+
 namespace circle_apx_nsp {
   struct Point {
     double x, y;
@@ -19,6 +21,9 @@ namespace circle_apx_nsp {
   };
 }
 
+// Least squares fit of a circle. The result is not finite for coordinates
+// that are not finite or overflow, and the radius is not finite for an
+// empty point set.
 circle_apx_nsp::Circle apx_circle(const std::vector<circle_apx_nsp::Point> &points) {
   size_t N = points.size();
 
@@ -69,16 +74,6 @@ circle_apx_nsp::Circle apx_circle(const std::vector<circle_apx_nsp::Point> &poin
                       2 * sy * y_bar + N * y_bar * y_bar) /
                      N;
 
-  if (!std::isfinite(x_bar) || !std::isfinite(y_bar)) {
-    std::cout.precision(20);
-    std::cout << "not finite from:" << std::endl;
-    for (auto p : points) {
-      std::cout << p.x << " " << p.y << std::endl;
-    }
-    std::cout << a1 * b2 - a2 * b1 << std::endl;
-    std::cout << "not finite up" << std::endl;
-  }
-
   return {x_bar, y_bar, std::sqrt(R_squared)};
 }
 
@@ -5,6 +5,7 @@
 #include <cmath>
 #include <iostream>
 #include <optional>
+#include <type_traits>
 #include <vector>
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
@@ -13,17 +14,21 @@
 
 #include <boost/format.hpp>
 
-using K = CGAL::Exact_predicates_inexact_constructions_kernel;
-using Point_2 = K::Point_2;
-using Segment_2 = K::Segment_2;
-using Polygon_2 = CGAL::Polygon_2<K>;
-using Polygon_with_holes_2 = CGAL::Polygon_with_holes_2<K>;
-using Circle_2 = K::Circle_2;
+// Thread safety: no function keeps state between calls, concurrent calls are
+// safe as long as each thread passes its own cups to high_points (they are
+// sorted in place). The filtered CGAL predicates switch the FPU rounding mode
+// per thread, which requires CGAL_HAS_THREADS (set when compiling with thread
+// support).
 
-struct Interval {
-  K::FT begin, end;
+// The label fitting is generic in the CGAL kernel: the cups and high points
+// only need constructions, the exactness of the predicates matters for the
+// point in polygon tests of the caller alone. The aliases and functions
+// outside of the namespace use the exact predicates kernel K.
+namespace label_fit {
+template <class FT> struct Interval {
+  FT begin, end;
   Interval() = default;
-  Interval(K::FT b, K::FT e) {
+  Interval(FT b, FT e) {
     auto [smaller, larger] = std::minmax(b, e);
     begin = smaller;
     end = larger;
@@ -43,9 +48,9 @@ struct Interval {
   auto mid() { return (end + begin) / 2.; }
 };
 
-struct AngleRange {
-  K::FT begin, end;
-  AngleRange(K::FT b, K::FT e) {
+template <class FT> struct AngleRange {
+  FT begin, end;
+  AngleRange(FT b, FT e) {
     if (e < b)
       std::swap(b, e);
     if (e - b > M_PI) {
@@ -60,15 +65,18 @@ struct AngleRange {
   }
 };
 
-auto point_angle(const Point_2 &p, const Point_2 &q) {
+template <class Point> auto point_angle(const Point &p, const Point &q) {
   return std::atan2(q.y() - p.y(), q.x() - p.x());
 }
 
-auto angle_range(const Point_2 &p, const Segment_2 &s) {
-  return AngleRange{point_angle(p, s.source()), point_angle(p, s.target())};
+template <class Point, class Segment>
+auto angle_range(const Point &p, const Segment &s) {
+  using FT = decltype(point_angle(p, s.source()));
+  return AngleRange<FT>{point_angle(p, s.source()), point_angle(p, s.target())};
 }
 
-auto distance(const Circle_2 &circle, const Segment_2 &segment) {
+template <class Circle, class Segment>
+auto distance(const Circle &circle, const Segment &segment) {
   auto c = circle.center();
   auto cs = CGAL::squared_distance(c, segment);
   auto cp = CGAL::squared_distance(c, segment.source());
@@ -80,11 +88,13 @@ auto distance(const Circle_2 &circle, const Segment_2 &segment) {
   return 0.;
 }
 
-struct Cup {
-  K::FT height;
-  Interval range;
+template <class Kernel> struct Cup {
+  using FT = typename Kernel::FT;
+  FT height;
+  Interval<FT> range;
   Cup(const Cup &cup) = default;
-  Cup(const Segment_2 &s, const Circle_2 &c, double aspect) {
+  Cup(const typename Kernel::Segment_2 &s, const typename Kernel::Circle_2 &c,
+      double aspect) {
     double r = std::sqrt(c.squared_radius());
     double x = aspect * M_PI;
     double h_max = r * x / (1 + x);
@@ -94,8 +104,8 @@ struct Cup {
     double L = H / aspect;
     double delta_angle = L / rb / 2;
     auto angle_interval = angle_range(c.center(), s);
-    range = Interval(angle_interval.begin - delta_angle,
-                     angle_interval.end + delta_angle);
+    range = Interval<FT>(angle_interval.begin - delta_angle,
+                         angle_interval.end + delta_angle);
     height = delta_angle;
   }
   std::string str() {
@@ -103,22 +113,26 @@ struct Cup {
   }
 };
 
-std::vector<Cup> compute_cups(std::vector<Segment_2> &segments, Circle_2 c,
-                              double aspect) {
-  std::vector<Cup> result;
+template <class Kernel>
+std::vector<Cup<Kernel>>
+compute_cups(const std::vector<typename Kernel::Segment_2> &segments,
+             typename Kernel::Circle_2 c, double aspect) {
+  std::vector<Cup<Kernel>> result;
   result.reserve(segments.size());
-  std::transform(segments.begin(), segments.end(), std::back_inserter(result),
-                 [&](const Segment_2 &s) { return Cup(s, c, aspect); });
+  std::transform(
+      segments.begin(), segments.end(), std::back_inserter(result),
+      [&](const typename Kernel::Segment_2 &s) { return Cup<Kernel>(s, c, aspect); });
   return result;
 }
 
-std::vector<Cup> compute_shifted_cups(const std::vector<Cup> &cups,
-                                      double amount) {
-  std::vector<Cup> result;
+template <class Kernel>
+std::vector<Cup<Kernel>> compute_shifted_cups(const std::vector<Cup<Kernel>> &cups,
+                                              double amount) {
+  std::vector<Cup<Kernel>> result;
   result.reserve(cups.size());
   std::transform(cups.begin(), cups.end(), std::back_inserter(result),
-                 [&](const Cup &cup) {
-                   Cup shifted_cup(cup);
+                 [&](const Cup<Kernel> &cup) {
+                   Cup<Kernel> shifted_cup(cup);
                    shifted_cup.range.begin += amount;
                    shifted_cup.range.end += amount;
                    return shifted_cup;
@@ -126,29 +140,56 @@ std::vector<Cup> compute_shifted_cups(const std::vector<Cup> &cups,
   return result;
 }
 
-std::vector<Cup> compute_all_cups(std::vector<Segment_2> &segments, Circle_2 c,
-                                  double aspect) {
-  auto cups = compute_cups(segments, c, aspect);
-  auto left_cups = compute_shifted_cups(cups, -2 * M_PI);
-  auto right_cups = compute_shifted_cups(cups, 2 * M_PI);
-  cups.insert(cups.end(), left_cups.begin(), left_cups.end());
-  cups.insert(cups.end(), right_cups.begin(), right_cups.end());
-  return cups;
+// The cups of all segments, repeated shifted by -2 pi and 2 pi. Writes into
+// cups to reuse its memory.
+template <class Kernel>
+void compute_all_cups(const std::vector<typename Kernel::Segment_2> &segments,
+                      typename Kernel::Circle_2 c, double aspect,
+                      std::vector<Cup<Kernel>> &cups) {
+  cups.clear();
+  cups.reserve(3 * segments.size());
+  for (const auto &s : segments)
+    cups.emplace_back(s, c, aspect);
+  size_t n = cups.size();
+  for (double amount : {-2 * M_PI, 2 * M_PI}) {
+    for (size_t i = 0; i < n; ++i) {
+      Cup<Kernel> shifted_cup(cups[i]);
+      shifted_cup.range.begin += amount;
+      shifted_cup.range.end += amount;
+      cups.push_back(shifted_cup);
+    }
+  }
 }
 
-std::vector<Point_2> high_points(std::vector<Cup> &cups) {
-  std::vector<Point_2> high_points;
-  std::vector<Interval> intervals = {{-2 * M_PI, 2 * M_PI}};
+// Working memory of high_points
+template <class FT> struct HighPointBuffers {
+  std::vector<Interval<FT>> intervals, shrunken_intervals, filtered_intervals;
+};
+
+// Writes the high points of the cups, angle and height, into high_points
+// and reuses the memory of the buffers. The cups are sorted in place.
+template <class Kernel>
+void high_points(std::vector<Cup<Kernel>> &cups,
+                 std::vector<typename Kernel::Point_2> &high_points,
+                 HighPointBuffers<typename Kernel::FT> &buffers) {
+  using Interval = label_fit::Interval<typename Kernel::FT>;
+  auto &intervals = buffers.intervals;
+  auto &shrunken_intervals = buffers.shrunken_intervals;
+  auto &filtered_intervals = buffers.filtered_intervals;
+  high_points.clear();
+  intervals.assign(1, {-2 * M_PI, 2 * M_PI});
   double curr_h = 0;
   std::sort(cups.begin(), cups.end(),
-            [](Cup c1, Cup c2) { return c1.height < c2.height; });
+            [](const Cup<Kernel> &c1, const Cup<Kernel> &c2) {
+              return c1.height < c2.height;
+            });
   // for (auto [height, interval] : cups) {
-  for (auto cup : cups) {
+  for (const auto &cup : cups) {
     auto height = cup.height;
     auto interval = cup.range;
     double dh = height - curr_h;
     double dx = 2 * dh;
-    std::vector<Interval> shrunken_intervals;
+    shrunken_intervals.clear();
     std::for_each(intervals.begin(), intervals.end(), [&](Interval i) {
       if (i.len() < dx)
         high_points.emplace_back(i.mid(), curr_h + i.len() / 2);
@@ -156,7 +197,7 @@ std::vector<Point_2> high_points(std::vector<Cup> &cups) {
         shrunken_intervals.emplace_back(i.begin + dx / 2., i.end - dx / 2.);
       }
     });
-    std::vector<Interval> filtered_intervals;
+    filtered_intervals.clear();
     std::for_each(shrunken_intervals.begin(), shrunken_intervals.end(),
                   [&](Interval i) {
                     auto [i1, i2] = i.sub(interval);
@@ -170,22 +211,76 @@ std::vector<Point_2> high_points(std::vector<Cup> &cups) {
                     }
                   });
     curr_h = height;
-    intervals = filtered_intervals;
+    intervals.swap(filtered_intervals);
   }
 
   std::for_each(intervals.begin(), intervals.end(), [&](Interval i) {
     high_points.emplace_back(i.mid(), curr_h + i.len() / 2);
   });
-
-  return high_points;
 }
 
-Point_2 polar_point(Circle_2 c, double angle) {
+template <class Circle>
+auto polar_point(const Circle &c, double angle)
+    -> std::decay_t<decltype(c.center())> {
   double x = c.center().x();
   double y = c.center().y();
   double r = std::sqrt(c.squared_radius());
   return {x + r * std::cos(angle), y + r * std::sin(angle)};
 }
+} // namespace label_fit
+
+using K = CGAL::Exact_predicates_inexact_constructions_kernel;
+using Point_2 = K::Point_2;
+using Segment_2 = K::Segment_2;
+using Polygon_2 = CGAL::Polygon_2<K>;
+using Polygon_with_holes_2 = CGAL::Polygon_with_holes_2<K>;
+using Circle_2 = K::Circle_2;
+
+using Interval = label_fit::Interval<K::FT>;
+using AngleRange = label_fit::AngleRange<K::FT>;
+using Cup = label_fit::Cup<K>;
+using HighPointBuffers = label_fit::HighPointBuffers<K::FT>;
+using label_fit::angle_range;
+using label_fit::distance;
+using label_fit::point_angle;
+using label_fit::polar_point;
+
+std::vector<Cup> compute_cups(const std::vector<Segment_2> &segments, Circle_2 c,
+                              double aspect) {
+  return label_fit::compute_cups<K>(segments, c, aspect);
+}
+
+std::vector<Cup> compute_shifted_cups(const std::vector<Cup> &cups,
+                                      double amount) {
+  return label_fit::compute_shifted_cups<K>(cups, amount);
+}
+
+// Same as compute_all_cups below, but writes into cups to reuse its memory
+void compute_all_cups(const std::vector<Segment_2> &segments, Circle_2 c,
+                      double aspect, std::vector<Cup> &cups) {
+  label_fit::compute_all_cups<K>(segments, c, aspect, cups);
+}
+
+std::vector<Cup> compute_all_cups(const std::vector<Segment_2> &segments, Circle_2 c,
+                                  double aspect) {
+  std::vector<Cup> cups;
+  compute_all_cups(segments, c, aspect, cups);
+  return cups;
+}
+
+// Same as high_points below, but writes into high_points and reuses the
+// memory of the buffers
+void high_points(std::vector<Cup> &cups, std::vector<Point_2> &high_points,
+                 HighPointBuffers &buffers) {
+  label_fit::high_points<K>(cups, high_points, buffers);
+}
+
+std::vector<Point_2> high_points(std::vector<Cup> &cups) {
+  std::vector<Point_2> result;
+  HighPointBuffers buffers;
+  high_points(cups, result, buffers);
+  return result;
+}
 
 Point_2 compute_labelling(Polygon_with_holes_2 &ph, double aspect,
                           K::Circle_2 circle) {
@@ -0,0 +1,221 @@
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/python.hpp>
+#include <boost/python/extract.hpp>
+#include <boost/python/list.hpp>
+
+#include "liblabeling.h"
+
+using namespace boost::python;
+
+namespace {
+  void raise(PyObject *type, const std::string &message) {
+    PyErr_SetString(type, message.c_str());
+    throw_error_already_set();
+  }
+
+  // Releases the GIL for the lifetime of the object. Python objects must
+  // not be touched while it exists.
+  class AllowThreads {
+  public:
+    AllowThreads() : state(PyEval_SaveThread()) {}
+    ~AllowThreads() { PyEval_RestoreThread(state); }
+    AllowThreads(const AllowThreads &) = delete;
+    AllowThreads &operator=(const AllowThreads &) = delete;
+  private:
+    PyThreadState *state;
+  };
+
+  // Accepts Python ints and integer numpy scalars alike
+  size_t toIndex(object value) {
+    handle<> index(PyNumber_Index(value.ptr()));
+    size_t result = PyLong_AsSize_t(index.get());
+    if (PyErr_Occurred()) {
+      throw_error_already_set();
+    }
+    return result;
+  }
+
+  struct Buffer {
+    Py_buffer view{};
+    bool acquired = false;
+
+    Buffer() = default;
+    Buffer(const Buffer &) = delete;
+    Buffer &operator=(const Buffer &) = delete;
+    ~Buffer() {
+      if (acquired) {
+        PyBuffer_Release(&view);
+      }
+    }
+  };
+
+  // Coordinates of a polygon taken from an object supporting the buffer
+  // protocol (e.g. a numpy array of shape (n, 2) and dtype float64) without
+  // copying them, plus the ring offsets.
+  class Coordinates {
+  public:
+    Coordinates(object coords, object offsets) {
+      if (PyObject_GetBuffer(coords.ptr(), &data.view, PyBUF_STRIDES | PyBUF_FORMAT) != 0) {
+        throw_error_already_set();
+      }
+      data.acquired = true;
+      const Py_buffer &buffer = data.view;
+
+      std::string format = buffer.format ? buffer.format : "B";
+      if (format != "d" && format != "=d" && format != "<d" && format != "@d") {
+        raise(PyExc_TypeError, "coordinates must be float64, got format '" + format + "'");
+      }
+      if (buffer.ndim != 2 || buffer.shape[1] < 2) {
+        raise(PyExc_ValueError, "coordinates must have the shape (n, 2)");
+      }
+      Py_ssize_t item = sizeof(double);
+      if (buffer.strides[0] <= 0 || buffer.strides[1] <= 0
+          || buffer.strides[0] % item != 0 || buffer.strides[1] % item != 0) {
+        raise(PyExc_ValueError, "coordinates must have positive strides aligned to float64");
+      }
+
+      size_t points = buffer.shape[0];
+      if (offsets.is_none()) {
+        ringOffsets = {0, points};
+      } else {
+        for (ssize_t i(0); i < len(offsets); ++i) {
+          ringOffsets.push_back(toIndex(offsets[i]));
+        }
+        if (ringOffsets.size() < 2 || ringOffsets.front() != 0 || ringOffsets.back() > points) {
+          raise(PyExc_ValueError, "ring offsets must hold at least two entries, start at 0 and end within the coordinates");
+        }
+        if (!std::is_sorted(ringOffsets.begin(), ringOffsets.end())) {
+          raise(PyExc_ValueError, "ring offsets must not decrease");
+        }
+      }
+
+      const double *x = static_cast<const double *>(buffer.buf);
+      view = {x, x + buffer.strides[1] / item, size_t(buffer.strides[0] / item),
+              ringOffsets.data(), ringOffsets.size() - 1};
+    }
+
+    Coordinates(const Coordinates &) = delete;
+    Coordinates &operator=(const Coordinates &) = delete;
+
+    liblabel::PolygonView view{};
+  private:
+    Buffer data;
+    std::vector<size_t> ringOffsets;
+  };
+
+  object toPython(const std::optional<liblabel::AreaLabel> &label) {
+    return label ? object(*label) : object();
+  }
+
+  object compute_label(double aspect, object coords, object offsets, liblabel::Config config) {
+    Coordinates polygon(coords, offsets);
+    std::optional<liblabel::AreaLabel> label;
+    std::string error;
+    bool invalid = false;
+    {
+      AllowThreads allow;
+      try {
+        label = liblabel::computeLabel(aspect, polygon.view, false, config);
+      } catch (const std::invalid_argument &e) {
+        invalid = true;
+        error = e.what();
+      } catch (const std::exception &e) {
+        error = e.what();
+      }
+    }
+    if (!error.empty()) {
+      raise(invalid ? PyExc_ValueError : PyExc_RuntimeError, error);
+    }
+    return toPython(label);
+  }
+
+  // polygons is a sequence of coordinate arrays or of (coordinates,
+  // ring offsets) pairs, one per aspect.
+  list compute_labels(object aspects, object polygons, liblabel::Config config, size_t threads) {
+    ssize_t count = len(polygons);
+    if (len(aspects) != count) {
+      raise(PyExc_ValueError, "aspects and polygons differ in length");
+    }
+
+    std::vector<std::unique_ptr<Coordinates>> inputs;
+    std::vector<liblabel::LabelJob> jobs;
+    inputs.reserve(count);
+    jobs.reserve(count);
+    for (ssize_t i(0); i < count; ++i) {
+      object p = polygons[i];
+      if (PyTuple_Check(p.ptr())) {
+        inputs.emplace_back(new Coordinates(p[0], p[1]));
+      } else {
+        inputs.emplace_back(new Coordinates(p, object()));
+      }
+      jobs.push_back({extract<double>(aspects[i]), nullptr, config, &inputs.back()->view});
+    }
+
+    liblabel::BatchConfig batch;
+    batch.threads = threads;
+    std::vector<liblabel::LabelResult> results;
+    {
+      AllowThreads allow;
+      results = liblabel::computeLabels(jobs, batch);
+    }
+
+    list labels;
+    for (size_t i(0); i < results.size(); ++i) {
+      if (!results[i].error.empty()) {
+        raise(PyExc_RuntimeError, "polygon " + std::to_string(i) + ": " + results[i].error);
+      }
+      labels.append(toPython(results[i].label));
+    }
+    return labels;
+  }
+
+  tuple center(const liblabel::AreaLabel &label) {
+    return make_tuple(label.center.x, label.center.y);
+  }
+}
+
+BOOST_PYTHON_MODULE(c_labeling) {
+  enum_<liblabel::Config::Sampling>("Sampling")
+      .value("Uniform", liblabel::Config::Sampling::Uniform)
+      .value("Adaptive", liblabel::Config::Sampling::Adaptive);
+
+  enum_<liblabel::Config::Skeleton>("Skeleton")
+      .value("ConformingCDT", liblabel::Config::Skeleton::ConformingCDT)
+      .value("SegmentVoronoi", liblabel::Config::Skeleton::SegmentVoronoi);
+
+  enum_<liblabel::Config::Kernel>("Kernel")
+      .value("ExactPredicates", liblabel::Config::Kernel::ExactPredicates)
+      .value("Fast", liblabel::Config::Kernel::Fast);
+
+  class_<liblabel::Config>("Config")
+      .def_readwrite("step_size", &liblabel::Config::stepSize)
+      .def_readwrite("number_of_paths", &liblabel::Config::numberOfPaths)
+      .def_readwrite("vertex_budget", &liblabel::Config::vertexBudget)
+      .def_readwrite("sampling", &liblabel::Config::sampling)
+      .def_readwrite("skeleton", &liblabel::Config::skeleton)
+      .def_readwrite("kernel", &liblabel::Config::kernel)
+      .def_readwrite("simplify_tolerance", &liblabel::Config::simplifyTolerance)
+      .def_readwrite("evaluation_threads", &liblabel::Config::evaluationThreads)
+      .def_readwrite("prune_candidates", &liblabel::Config::pruneCandidates)
+      .def_readwrite("compact_skeleton", &liblabel::Config::compactSkeleton)
+      .def_readwrite("time_budget", &liblabel::Config::timeBudget);
+
+  class_<liblabel::AreaLabel>("AreaLabel", no_init)
+      .add_property("center", &center)
+      .def_readonly("rad_lower", &liblabel::AreaLabel::rad_lower)
+      .def_readonly("rad_upper", &liblabel::AreaLabel::rad_upper)
+      .def_readonly("from_angle", &liblabel::AreaLabel::from)
+      .def_readonly("to_angle", &liblabel::AreaLabel::to)
+      .def_readonly("partial", &liblabel::AreaLabel::partial);
+
+  def("compute_label", &compute_label,
+      (arg("aspect"), arg("coords"), arg("ring_offsets") = object(), arg("config") = liblabel::Config()));
+  def("compute_labels", &compute_labels,
+      (arg("aspects"), arg("polygons"), arg("config") = liblabel::Config(), arg("threads") = 0));
+}
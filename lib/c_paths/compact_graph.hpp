@@ -0,0 +1,286 @@
+#ifndef COMPACT_GRAPH_HPP
+#define COMPACT_GRAPH_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "csr_graph.hpp"
+
+// Reduction of the skeleton graph before the path search. The skeleton of a
+// conforming CDT consists of long chains of degree 2 vertices, which only
+// add steps to every search, and short spurs towards the boundary vertices.
+// compact prunes the spurs that cannot carry a label and contracts every
+// chain into a single edge, whose weight is the sum of the weights of the
+// chain and whose capacity is the smallest one on it. The vertices of the
+// chains are kept with the edge, so expand_path turns a path of the
+// compacted graph back into the path of the skeleton.
+//
+// Paths of the compacted graph run between branch vertices and leaves, the
+// search no longer ends halfway along a chain. A chain also only exists as
+// a whole at a capacity level, while a part of it with larger capacities
+// may take part in the search of the full graph.
+
+namespace csr {
+
+// The chains of the edges of a compacted graph. The vertices inside of the
+// chain of edge e, seen from its end chain_start[e], are chain_nodes
+// [chain_begin[e] .. chain_begin[e + 1]).
+struct Compaction {
+  std::vector<Index> chain_start;
+  std::vector<Index> chain_begin;
+  std::vector<Node> chain_nodes;
+  size_t pruned_spurs = 0;
+};
+
+// Memory reused by compact
+struct CompactionBuffers {
+  std::vector<Index> degree;  // arcs left after the pruning
+  std::vector<char> loop;
+  std::vector<char> terminal; // ends of the chains
+  std::vector<char> removed;  // edge -> pruned
+  std::vector<char> used;     // edge -> contracted
+  std::vector<Index> steps;   // arcs of the chain of a spur
+  // The chains, as a start vertex and the arcs stepped along from it
+  struct Chain {
+    Vertex start;
+    Index first, count;
+  };
+  std::vector<Chain> chains;
+  std::vector<Index> chain_arcs;
+  std::vector<Index> order;
+  std::vector<longest_paths::Segment> segments;
+  Builder builder;
+};
+
+namespace detail {
+inline double arc_length(const CsrGraph &g, Vertex v, Index a) {
+  const Node &p = g.nodes[v], &q = g.nodes[g.arc_target[a]];
+  return std::hypot(p.x - q.x, p.y - q.y);
+}
+
+// The arc of the degree 2 vertex v that does not belong to the edge
+inline Index other_arc(const CsrGraph &g, const CompactionBuffers &b,
+                       Vertex v, Index edge) {
+  for (Index a = g.arc_begin[v], end = g.arc_begin[v + 1]; a < end; ++a)
+    if (!b.removed[g.arc_edge[a]] && g.arc_edge[a] != edge)
+      return a;
+  return g.arc_begin[v];
+}
+
+// Follows the chain from v along the arc a until a terminal vertex, the
+// arcs are appended to b.chain_arcs. Returns the terminal vertex.
+inline Vertex follow_chain(const CsrGraph &g, CompactionBuffers &b, Vertex v,
+                           Index a) {
+  for (;;) {
+    b.used[g.arc_edge[a]] = true;
+    b.chain_arcs.push_back(a);
+    v = g.arc_target[a];
+    if (b.terminal[v])
+      return v;
+    a = other_arc(g, b, v, g.arc_edge[a]);
+  }
+}
+} // namespace detail
+
+// Writes the compacted graph of g into out and the geometry of its chains
+// into c, reusing their memory.
+//
+// A spur is a chain from a leaf to a branch vertex. It is pruned if it is
+// no longer than the clearance at the branch vertex and never wider, so it
+// stays inside of the largest empty circle there and any label along it
+// fits at the branch vertex already. The rule does not depend on the aspect
+// ratio, since one compaction serves the searches of all aspects. At least
+// two chains are kept at every branch vertex, so pruning never cuts a
+// component short.
+//
+// Vertices of the compacted graph are the branch vertices, the leaves and
+// the vertices with a loop. Chains that would become loops or that connect
+// the same two vertices as another chain keep inner vertices, so the
+// compacted graph has no two edges with different geometry between the
+// same vertices and its vertex paths identify the skeleton paths.
+inline void compact(const CsrGraph &g, CsrGraph &out, Compaction &c,
+                    CompactionBuffers &b) {
+  size_t n = g.num_vertices();
+  b.degree.assign(n, 0);
+  b.loop.assign(n, false);
+  b.terminal.resize(n);
+  b.removed.assign(g.edge_count, false);
+  b.used.assign(g.edge_count, false);
+  for (Vertex v = 0; v < n; ++v) {
+    // A loop has a single arc but counts twice
+    b.degree[v] = g.arc_begin[v + 1] - g.arc_begin[v];
+    for (Index a = g.arc_begin[v]; a < g.arc_begin[v + 1]; ++a) {
+      if (g.arc_target[a] == v) {
+        b.loop[v] = true;
+        ++b.degree[v];
+      }
+    }
+  }
+  auto update_terminals = [&] {
+    for (Vertex v = 0; v < n; ++v)
+      b.terminal[v] = b.degree[v] != 2 || b.loop[v];
+  };
+  update_terminals();
+
+  c.pruned_spurs = 0;
+  for (Vertex leaf = 0; leaf < n; ++leaf) {
+    if (b.degree[leaf] != 1 || b.loop[leaf])
+      continue;
+    b.steps.clear();
+    double length = 0, width = 0;
+    Vertex v = leaf;
+    Index a = g.arc_begin[leaf];
+    for (;;) {
+      b.steps.push_back(a);
+      length += detail::arc_length(g, v, a);
+      width = std::max(width, g.arc_capacity[a]);
+      v = g.arc_target[a];
+      if (b.terminal[v])
+        break;
+      a = detail::other_arc(g, b, v, g.arc_edge[a]);
+    }
+    if (b.degree[v] <= 2)
+      continue;
+    double clearance = 0;
+    for (Index e = g.arc_begin[v]; e < g.arc_begin[v + 1]; ++e)
+      clearance = std::max(clearance, g.arc_capacity[e]);
+    if (length > clearance || width > clearance)
+      continue;
+    b.degree[leaf] = 0;
+    for (Index step : b.steps) {
+      b.removed[g.arc_edge[step]] = true;
+      if (g.arc_target[step] != v)
+        b.degree[g.arc_target[step]] = 0;
+    }
+    --b.degree[v];
+    ++c.pruned_spurs;
+  }
+  // Branch vertices left with two chains become inner vertices
+  update_terminals();
+
+  b.chains.clear();
+  b.chain_arcs.clear();
+  auto add_chains = [&](Vertex v) {
+    for (Index a = g.arc_begin[v]; a < g.arc_begin[v + 1]; ++a) {
+      if (b.removed[g.arc_edge[a]] || b.used[g.arc_edge[a]])
+        continue;
+      Index first = Index(b.chain_arcs.size());
+      detail::follow_chain(g, b, v, a);
+      b.chains.push_back({v, first, Index(b.chain_arcs.size()) - first});
+    }
+  };
+  for (Vertex v = 0; v < n; ++v)
+    if (b.terminal[v])
+      add_chains(v);
+  // Cycles without a branch vertex start at their first vertex
+  for (Vertex v = 0; v < n; ++v) {
+    if (b.terminal[v] || b.degree[v] == 0)
+      continue;
+    Index a = detail::other_arc(g, b, v, Index(g.edge_count));
+    if (b.used[g.arc_edge[a]])
+      continue;
+    b.terminal[v] = true;
+    add_chains(v);
+  }
+
+  // Chains between the same vertices, ordered by their ends. Splitting a
+  // chain at an inner vertex gives it ends no other chain has.
+  auto ends = [&](const CompactionBuffers::Chain &chain) {
+    Vertex u = chain.start;
+    Vertex v = g.arc_target[b.chain_arcs[chain.first + chain.count - 1]];
+    return std::make_pair(std::min(u, v), std::max(u, v));
+  };
+  b.order.resize(b.chains.size());
+  for (Index i = 0; i < b.order.size(); ++i)
+    b.order[i] = i;
+  std::sort(b.order.begin(), b.order.end(), [&](Index i, Index j) {
+    return std::make_pair(ends(b.chains[i]), i) <
+           std::make_pair(ends(b.chains[j]), j);
+  });
+  size_t chain_count = b.chains.size();
+  auto split = [&](Index i, Index at) {
+    auto chain = b.chains[i];
+    Vertex start = g.arc_target[b.chain_arcs[chain.first + at - 1]];
+    b.chains.push_back({start, chain.first + at, chain.count - at});
+    b.chains[i].count = at;
+  };
+  for (size_t k = 0; k < chain_count;) {
+    size_t group = k + 1;
+    while (group < chain_count &&
+           ends(b.chains[b.order[group]]) == ends(b.chains[b.order[k]]))
+      ++group;
+    for (size_t l = k; l < group; ++l) {
+      Index i = b.order[l];
+      Index count = b.chains[i].count;
+      auto [u, v] = ends(b.chains[i]);
+      if (u == v && count >= 3) {
+        split(i, 2 * count / 3);
+        split(i, count / 3);
+      } else if ((u == v || group - k > 1) && count >= 2) {
+        split(i, count / 2);
+      }
+    }
+    k = group;
+  }
+
+  b.segments.clear();
+  for (const auto &chain : b.chains) {
+    Vertex u = chain.start;
+    double weight = 0, cap = std::numeric_limits<double>::max();
+    for (Index s = chain.first; s < chain.first + chain.count; ++s) {
+      weight += g.arc_weight[b.chain_arcs[s]];
+      cap = std::min(cap, g.arc_capacity[b.chain_arcs[s]]);
+    }
+    Vertex v = g.arc_target[b.chain_arcs[chain.first + chain.count - 1]];
+    b.segments.push_back({g.nodes[u], g.nodes[v], weight, cap, u, v});
+  }
+  from_edges(b.segments, out, b.builder);
+
+  c.chain_start.resize(b.chains.size());
+  c.chain_begin.assign(1, 0);
+  c.chain_nodes.clear();
+  for (size_t e = 0; e < b.chains.size(); ++e) {
+    const auto &chain = b.chains[e];
+    c.chain_start[e] = b.builder.vertex_of[chain.start];
+    for (Index s = chain.first; s + 1 < chain.first + chain.count; ++s)
+      c.chain_nodes.push_back(g.nodes[g.arc_target[b.chain_arcs[s]]]);
+    c.chain_begin.push_back(Index(c.chain_nodes.size()));
+  }
+}
+
+// Writes the points of the skeleton path along the vertex path of the
+// compacted graph into points
+inline void expand_path(const CsrGraph &g, const Compaction &c,
+                        const std::vector<Vertex> &path,
+                        std::vector<Node> &points) {
+  points.clear();
+  for (size_t i = 0; i < path.size(); ++i) {
+    Vertex u = path[i];
+    points.push_back(g.nodes[u]);
+    if (i + 1 == path.size())
+      break;
+    // Only one of the edges between two vertices has inner vertices
+    Index edge = g.arc_edge[g.arc_begin[u]];
+    for (Index a = g.arc_begin[u]; a < g.arc_begin[u + 1]; ++a) {
+      if (g.arc_target[a] != path[i + 1])
+        continue;
+      edge = g.arc_edge[a];
+      if (c.chain_begin[edge] != c.chain_begin[edge + 1])
+        break;
+    }
+    auto begin = c.chain_nodes.begin() + c.chain_begin[edge];
+    auto end = c.chain_nodes.begin() + c.chain_begin[edge + 1];
+    if (c.chain_start[edge] == u)
+      points.insert(points.end(), begin, end);
+    else
+      points.insert(points.end(), std::make_reverse_iterator(end),
+                    std::make_reverse_iterator(begin));
+  }
+}
+} // namespace csr
+
+#endif /* COMPACT_GRAPH_HPP */
@@ -0,0 +1,580 @@
+#ifndef CSR_GRAPH_HPP
+#define CSR_GRAPH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include <boost/graph/detail/d_ary_heap.hpp>
+#include <boost/property_map/property_map.hpp>
+
+#include "longest_paths.hpp"
+
+// The skeleton graph in compressed sparse row form and the path search of
+// longest_paths.hpp on it. The arcs of a vertex are stored next to each
+// other with their weights and capacities in separate arrays, so a Dijkstra
+// step reads a few consecutive cache lines instead of following the edge
+// lists of an adjacency_list, and the capacity filter is a comparison on
+// the arc. Vertices are given by the ids of the edge endpoints (the faces of
+// the triangulation, see SkeletonEdge) instead of their coordinates.
+//
+// Thread safety: as for Graph, concurrent searches on the same CsrGraph are
+// safe as long as each one has its own buffers.
+
+namespace csr {
+using Index = std::uint32_t;
+
+struct CsrGraph {
+  std::vector<Node> nodes;
+  // The arcs of vertex v are arc_begin[v] .. arc_begin[v + 1] - 1, ordered
+  // by the index of their edge. An edge has an arc at both of its ends, a
+  // loop only one.
+  std::vector<Index> arc_begin;
+  std::vector<Index> arc_target;
+  std::vector<Index> arc_edge;
+  std::vector<double> arc_weight;
+  std::vector<double> arc_capacity;
+  size_t edge_count = 0;
+
+  size_t num_vertices() const { return nodes.size(); }
+  size_t num_arcs() const { return arc_target.size(); }
+};
+
+// Memory reused by from_edges
+struct Builder {
+  std::vector<Index> vertex_of; // endpoint id -> vertex
+  std::vector<Index> next;      // vertex -> next free arc
+};
+
+// Working memory of the searches on a CsrGraph, like PathSearchBuffers of
+// longest_paths.hpp for the Graph
+struct SearchBuffers {
+  // Dijkstra and the tree search
+  std::vector<Vertex> pred;
+  std::vector<double> dist;
+  std::vector<default_color_type> color;
+  std::vector<size_t> index_in_heap;
+  std::vector<Vertex> sources;
+  std::vector<Vertex> order;
+  std::vector<Vertex> tree_parent;
+  std::vector<double> parent_weight;
+  // The capacity hierarchy as a union-find over the edges by capacity
+  std::vector<std::pair<double, std::pair<Vertex, Vertex>>> by_capacity;
+  std::vector<Vertex> parent;
+  std::vector<size_t> set_vertices;
+  std::vector<size_t> set_edges;
+  // The components of a level, their furthest vertices and whether another
+  // vertex is as far
+  std::vector<size_t> components;
+  std::vector<Vertex> representatives;
+  std::vector<Vertex> furthest;
+  std::vector<char> tied;
+  // The node set of a level, the distances from its first set_sources
+  // vertices and the paths found on the current graph
+  std::vector<Vertex> node_set;
+  std::vector<char> in_node_set;
+  std::vector<double> set_dist;
+  size_t set_sources = 0;
+  std::vector<std::vector<Vertex>> level_paths;
+  std::vector<double> level_dists;
+};
+
+// Builds the graph of the edges (with src, trg, src_id, trg_id, weight and
+// cap like longest_paths::Segment) into g, reusing its memory. Endpoints
+// with the same id are the same vertex. Vertices are numbered in order of
+// their first occurrence, like from_edges of longest_paths.hpp does.
+template <class Edges>
+void from_edges(const Edges &edges, CsrGraph &g, Builder &b) {
+  const Index none = std::numeric_limits<Index>::max();
+  size_t ids = 0;
+  for (const auto &e : edges)
+    ids = std::max({ids, size_t(e.src_id) + 1, size_t(e.trg_id) + 1});
+  if (2 * edges.size() >= none || ids >= none)
+    throw std::length_error("Skeleton graph with more than 2^31 edges");
+
+  b.vertex_of.assign(ids, none);
+  g.nodes.clear();
+  g.arc_begin.assign(1, 0);
+  auto vertex = [&](size_t id, const Node &p) {
+    Index &v = b.vertex_of[id];
+    if (v == none) {
+      v = Index(g.nodes.size());
+      g.nodes.push_back(p);
+      g.arc_begin.push_back(0);
+    }
+    return v;
+  };
+  for (const auto &e : edges) {
+    Index u = vertex(e.src_id, e.src);
+    Index v = vertex(e.trg_id, e.trg);
+    ++g.arc_begin[u + 1];
+    if (u != v)
+      ++g.arc_begin[v + 1];
+  }
+  for (size_t v = 0; v < g.nodes.size(); ++v)
+    g.arc_begin[v + 1] += g.arc_begin[v];
+
+  size_t arcs = g.arc_begin.back();
+  g.arc_target.resize(arcs);
+  g.arc_edge.resize(arcs);
+  g.arc_weight.resize(arcs);
+  g.arc_capacity.resize(arcs);
+  b.next.assign(g.arc_begin.begin(), g.arc_begin.end() - 1);
+  auto add_arc = [&](Index from, Index to, Index edge, double weight,
+                     double cap) {
+    Index a = b.next[from]++;
+    g.arc_target[a] = to;
+    g.arc_edge[a] = edge;
+    g.arc_weight[a] = weight;
+    g.arc_capacity[a] = cap;
+  };
+  Index i = 0;
+  for (const auto &e : edges) {
+    Index u = b.vertex_of[e.src_id];
+    Index v = b.vertex_of[e.trg_id];
+    add_arc(u, v, i, e.weight, e.cap);
+    if (u != v)
+      add_arc(v, u, i, e.weight, e.cap);
+    ++i;
+  }
+  g.edge_count = edges.size();
+}
+
+// Dijkstra from the sources on the arcs with capacity >= min_cap, writes
+// b.pred and b.dist (sources are their own predecessor). examine(v) is
+// called for every reached vertex in order of increasing distance. Returns
+// the vertex examined last. The steps and the heap are the ones of
+// boost::dijkstra_shortest_paths, so ties are broken the same way and the
+// searches find the same paths as on the Graph of longest_paths.hpp.
+template <class VertexIt, class Examine>
+Vertex dijkstra(const CsrGraph &g, double min_cap, VertexIt sources_begin,
+                VertexIt sources_end, SearchBuffers &b, Examine examine) {
+  size_t n = g.num_vertices();
+  b.pred.resize(n);
+  b.dist.assign(n, std::numeric_limits<double>::max());
+  b.color.assign(n, white_color);
+  b.index_in_heap.resize(n);
+  auto dist = make_iterator_property_map(b.dist.begin(),
+                                         typed_identity_property_map<Vertex>());
+  auto index_in_heap = make_iterator_property_map(
+      b.index_in_heap.begin(), typed_identity_property_map<Vertex>());
+  d_ary_heap_indirect<Vertex, 4, decltype(index_in_heap), decltype(dist),
+                      std::less<double>>
+      queue(dist, index_in_heap);
+
+  for (auto it = sources_begin; it != sources_end; ++it) {
+    b.dist[*it] = 0;
+    b.pred[*it] = *it;
+  }
+  for (auto it = sources_begin; it != sources_end; ++it) {
+    b.color[*it] = gray_color;
+    queue.push(*it);
+  }
+
+  Vertex last = sources_begin != sources_end ? *sources_begin : 0;
+  while (!queue.empty()) {
+    Vertex v = queue.top();
+    queue.pop();
+    examine(v);
+    last = v;
+    for (Index a = g.arc_begin[v], end = g.arc_begin[v + 1]; a < end; ++a) {
+      if (g.arc_capacity[a] < min_cap)
+        continue;
+      Vertex w = g.arc_target[a];
+      if (b.color[w] == black_color)
+        continue;
+      double d = b.dist[v] + g.arc_weight[a];
+      bool decreased = d < b.dist[w];
+      if (decreased) {
+        b.dist[w] = d;
+        b.pred[w] = v;
+      }
+      if (b.color[w] == white_color) {
+        b.color[w] = gray_color;
+        queue.push(w);
+      } else if (decreased) {
+        queue.update(w);
+      }
+    }
+    b.color[v] = black_color;
+  }
+  return last;
+}
+
+// The searches of longest_paths.hpp end at the vertex their heap pops last.
+// It has the largest distance, so the distances alone determine it unless
+// another vertex has the same distance. Keeps the vertex of the largest
+// distance in furthest and notes in tied whether it is shared.
+inline void track_furthest(const std::vector<double> &dist, Vertex v,
+                           Vertex &furthest, char &tied) {
+  if (dist[v] > dist[furthest]) {
+    furthest = v;
+    tied = false;
+  } else if (dist[v] == dist[furthest] && v != furthest) {
+    tied = true;
+  }
+}
+
+// Union-find root of v in b.parent
+inline Vertex find_root(SearchBuffers &b, Vertex v) {
+  while (b.parent[v] != v) {
+    b.parent[v] = b.parent[b.parent[v]];
+    v = b.parent[v];
+  }
+  return v;
+}
+
+// Adds the edge u, v to the union-find b.parent, counting the vertices and
+// edges of every set so acyclic components can be told apart
+inline void unite(SearchBuffers &b, Vertex u, Vertex v) {
+  u = find_root(b, u);
+  v = find_root(b, v);
+  if (u == v) {
+    ++b.set_edges[u];
+    return;
+  }
+  Vertex keep = std::min(u, v), gone = std::max(u, v);
+  b.parent[gone] = keep;
+  b.set_vertices[keep] += b.set_vertices[gone];
+  b.set_edges[keep] += b.set_edges[gone] + 1;
+}
+
+// Whether the component of v in b.parent is a tree. The skeleton of a
+// polygon without holes is one, cycles come from holes.
+inline bool in_tree(SearchBuffers &b, Vertex v) {
+  Vertex r = find_root(b, v);
+  return b.set_edges[r] + 1 == b.set_vertices[r];
+}
+
+// Distances in the tree of root on the arcs with capacity >= min_cap from
+// the sources in it, in linear time instead of by Dijkstra: the nearest
+// source of a vertex is found in its subtree (first pass, leaves up) or
+// through its parent (second pass, root down). b.dist and b.pred have to be
+// 0 and the vertex itself for the sources and b.dist the maximum elsewhere,
+// the vertices of the tree are marked black in b.color.
+inline void tree_distances(const CsrGraph &g, double min_cap, Vertex root,
+                             SearchBuffers &b) {
+  b.tree_parent.resize(g.num_vertices());
+  b.parent_weight.resize(g.num_vertices());
+  b.order.assign(1, root);
+  b.color[root] = black_color;
+  b.tree_parent[root] = root;
+  b.parent_weight[root] = 0;
+  for (size_t i = 0; i < b.order.size(); ++i) {
+    Vertex v = b.order[i];
+    for (Index a = g.arc_begin[v], end = g.arc_begin[v + 1]; a < end; ++a) {
+      Vertex w = g.arc_target[a];
+      if (g.arc_capacity[a] < min_cap || b.color[w] == black_color)
+        continue;
+      b.color[w] = black_color;
+      b.tree_parent[w] = v;
+      b.parent_weight[w] = g.arc_weight[a];
+      b.order.push_back(w);
+    }
+  }
+
+  const double unreached = std::numeric_limits<double>::max();
+  for (size_t i = b.order.size(); i-- > 1;) {
+    Vertex v = b.order[i];
+    Vertex p = b.tree_parent[v];
+    if (b.dist[v] == unreached)
+      continue;
+    double d = b.dist[v] + b.parent_weight[v];
+    if (d < b.dist[p]) {
+      b.dist[p] = d;
+      b.pred[p] = v;
+    }
+  }
+  for (Vertex v : b.order) {
+    Vertex p = b.tree_parent[v];
+    double d = b.dist[p] + b.parent_weight[v];
+    if (v != root && d < b.dist[v]) {
+      b.dist[v] = d;
+      b.pred[v] = p;
+    }
+  }
+}
+
+// Writes the furthest vertex of every connected component of the arcs with
+// capacity >= min_cap into b.furthest, measured from the last vertex of the
+// component, as component_furthest_vertices of longest_paths.hpp does. The
+// components are the sets of b.parent, which has to hold exactly the edges
+// with capacity >= min_cap. Trees are searched by tree_distances, only the
+// components with cycles by Dijkstra. If a component has several furthest
+// vertices, all components are searched again by Dijkstra to find the one
+// boost's heap pops last.
+inline void component_furthest_vertices(const CsrGraph &g, double min_cap,
+                                        SearchBuffers &b) {
+  const size_t none = std::numeric_limits<size_t>::max();
+  size_t n = g.num_vertices();
+  // Components are numbered in order of their first vertex, as by
+  // boost::connected_components, b.components maps the roots to them
+  b.components.assign(n, none);
+  b.representatives.clear();
+  for (Vertex v = 0; v < n; ++v) {
+    size_t &component = b.components[find_root(b, v)];
+    if (component == none) {
+      component = b.representatives.size();
+      b.representatives.push_back(v);
+    }
+    b.representatives[component] = v;
+  }
+
+  b.sources.clear();
+  for (Vertex r : b.representatives)
+    if (!in_tree(b, r))
+      b.sources.push_back(r);
+  dijkstra(g, min_cap, b.sources.begin(), b.sources.end(), b, [](Vertex) {});
+  for (Vertex r : b.representatives) {
+    if (b.color[r] != white_color)
+      continue;
+    b.dist[r] = 0;
+    b.pred[r] = r;
+    tree_distances(g, min_cap, r, b);
+  }
+
+  b.furthest.assign(b.representatives.begin(), b.representatives.end());
+  b.tied.assign(b.representatives.size(), false);
+  for (Vertex v = 0; v < n; ++v) {
+    size_t component = b.components[find_root(b, v)];
+    track_furthest(b.dist, v, b.furthest[component], b.tied[component]);
+  }
+  if (std::find(b.tied.begin(), b.tied.end(), true) != b.tied.end())
+    dijkstra(g, min_cap, b.representatives.begin(), b.representatives.end(), b,
+             [&b](Vertex v) { b.furthest[b.components[find_root(b, v)]] = v; });
+}
+
+// Writes the distances from the sources into b.dist and b.pred and returns
+// the vertex furthest from them, the one Dijkstra examines last. As for
+// component_furthest_vertices b.parent has to hold the edges with capacity
+// >= min_cap.
+template <class VertexIt>
+Vertex furthest_from(const CsrGraph &g, double min_cap, VertexIt sources_begin,
+                     VertexIt sources_end, SearchBuffers &b) {
+  b.sources.clear();
+  for (auto it = sources_begin; it != sources_end; ++it)
+    if (!in_tree(b, *it))
+      b.sources.push_back(*it);
+  dijkstra(g, min_cap, b.sources.begin(), b.sources.end(), b, [](Vertex) {});
+
+  for (auto it = sources_begin; it != sources_end; ++it) {
+    if (b.color[*it] == white_color) {
+      b.dist[*it] = 0;
+      b.pred[*it] = *it;
+    }
+  }
+  for (auto it = sources_begin; it != sources_end; ++it)
+    if (b.color[*it] == white_color)
+      tree_distances(g, min_cap, *it, b);
+
+  const double unreached = std::numeric_limits<double>::max();
+  Vertex furthest = *sources_begin;
+  char tied = false;
+  for (Vertex v = 0; v < g.num_vertices(); ++v)
+    if (b.dist[v] != unreached)
+      track_furthest(b.dist, v, furthest, tied);
+  if (tied)
+    return dijkstra(g, min_cap, sources_begin, sources_end, b, [](Vertex) {});
+  return furthest;
+}
+
+// Writes the path to the vertex furthest from the sources into path and
+// returns its length, see furthest_from
+template <class VertexIt>
+double longest_path_from(const CsrGraph &g, double min_cap,
+                         VertexIt sources_begin, VertexIt sources_end,
+                         SearchBuffers &b, std::vector<Vertex> &path) {
+  Vertex last = furthest_from(g, min_cap, sources_begin, sources_end, b);
+  unpack_path(b.pred, last, path);
+  return b.dist[last];
+}
+
+// Lowers b.set_dist, the distances from b.node_set[0 .. b.set_sources - 1],
+// to the distances from the whole node set. The new sources only shorten
+// the distances around them, so the search starts from them alone and does
+// not pass vertices whose distance does not drop. Returns the vertex
+// furthest from the node set, as furthest_from would.
+inline Vertex add_node_set_sources(const CsrGraph &g, double min_cap,
+                                   SearchBuffers &b) {
+  size_t n = g.num_vertices();
+  b.color.assign(n, white_color);
+  b.index_in_heap.resize(n);
+  auto dist = make_iterator_property_map(b.set_dist.begin(),
+                                         typed_identity_property_map<Vertex>());
+  auto index_in_heap = make_iterator_property_map(
+      b.index_in_heap.begin(), typed_identity_property_map<Vertex>());
+  d_ary_heap_indirect<Vertex, 4, decltype(index_in_heap), decltype(dist),
+                      std::less<double>>
+      queue(dist, index_in_heap);
+
+  for (size_t i = b.set_sources; i < b.node_set.size(); ++i) {
+    Vertex s = b.node_set[i];
+    if (b.set_dist[s] > 0) {
+      b.set_dist[s] = 0;
+      b.color[s] = gray_color;
+      queue.push(s);
+    }
+  }
+  b.set_sources = b.node_set.size();
+
+  while (!queue.empty()) {
+    Vertex v = queue.top();
+    queue.pop();
+    b.color[v] = black_color;
+    for (Index a = g.arc_begin[v], end = g.arc_begin[v + 1]; a < end; ++a) {
+      if (g.arc_capacity[a] < min_cap)
+        continue;
+      Vertex w = g.arc_target[a];
+      double d = b.set_dist[v] + g.arc_weight[a];
+      if (d >= b.set_dist[w])
+        continue;
+      b.set_dist[w] = d;
+      if (b.color[w] == gray_color) {
+        queue.update(w);
+      } else {
+        b.color[w] = gray_color;
+        queue.push(w);
+      }
+    }
+  }
+
+  const double unreached = std::numeric_limits<double>::max();
+  Vertex furthest = b.node_set[0];
+  char tied = false;
+  for (Vertex v = 0; v < n; ++v)
+    if (b.set_dist[v] != unreached)
+      track_furthest(b.set_dist, v, furthest, tied);
+  if (tied)
+    return dijkstra(g, min_cap, b.node_set.begin(), b.node_set.end(), b,
+                    [](Vertex) {});
+  return furthest;
+}
+
+// find_distinct_paths of longest_paths.hpp on the compressed graph
+template <class Cancelled>
+size_t find_distinct_paths(const CsrGraph &graph, double aspect, double STEP,
+                           size_t k, SearchBuffers &b,
+                           std::vector<std::vector<Vertex>> &paths,
+                           Cancelled cancelled) {
+  size_t found = 0;
+  auto add_path = [&]() -> std::vector<Vertex> & {
+    if (paths.size() <= found)
+      paths.emplace_back();
+    return paths[found];
+  };
+
+  if (graph.num_arcs() == 0) {
+    paths.resize(0);
+    return 0;
+  }
+
+  // The capacity hierarchy: the edges by decreasing capacity are added to
+  // a union-find as CAP falls, like in Kruskal's algorithm, so the
+  // components of every level come without a traversal of the graph
+  b.by_capacity.clear();
+  for (Vertex v = 0; v < graph.num_vertices(); ++v)
+    for (Index a = graph.arc_begin[v]; a < graph.arc_begin[v + 1]; ++a)
+      if (v <= graph.arc_target[a])
+        b.by_capacity.push_back(
+            {graph.arc_capacity[a], {v, Vertex(graph.arc_target[a])}});
+  std::sort(b.by_capacity.begin(), b.by_capacity.end(),
+            [](const auto &x, const auto &y) { return x.first > y.first; });
+  double mincap = b.by_capacity.back().first;
+  double maxcap = b.by_capacity.front().first;
+  b.parent.resize(graph.num_vertices());
+  for (Vertex v = 0; v < graph.num_vertices(); ++v)
+    b.parent[v] = v;
+  b.set_vertices.assign(graph.num_vertices(), 1);
+  b.set_edges.assign(graph.num_vertices(), 0);
+
+  // A level without new edges searches the same graph from the same
+  // furthest vertices as the one before, so it finds the same paths in the
+  // same order and only compares them to a lower threshold. The paths of
+  // the current graph are kept and replayed instead of searched again,
+  // which makes small steps cheap. The node set is rebuilt in the same
+  // order, so the distances from its first b.set_sources vertices stay
+  // valid as well, and new paths only add their vertices to them.
+  size_t added = 0;
+  size_t searched = 0;
+  size_t levels = 0;
+  for (double CAP = maxcap; (CAP >= (mincap / STEP) || found == 0) && found < k;
+       CAP /= STEP) {
+    ++levels;
+
+    size_t before = added;
+    for (; added < b.by_capacity.size() && b.by_capacity[added].first >= CAP;
+         ++added)
+      unite(b, b.by_capacity[added].second.first,
+            b.by_capacity[added].second.second);
+    if (levels == 1 || added != before) {
+      component_furthest_vertices(graph, CAP, b);
+      searched = 0;
+      b.set_sources = 0;
+    }
+
+    b.in_node_set.assign(graph.num_vertices(), false);
+    b.node_set.clear();
+    for (Vertex v : b.furthest) {
+      if (!b.in_node_set[v]) {
+        b.in_node_set[v] = true;
+        b.node_set.push_back(v);
+      }
+    }
+
+    for (size_t i = 0; found < k; ++i) {
+      if (cancelled()) {
+        paths.resize(found);
+        return levels;
+      }
+      auto &path = add_path();
+      if (i == searched) {
+        Vertex start;
+        if (b.set_sources == 0) {
+          start = furthest_from(graph, CAP, b.node_set.begin(),
+                                b.node_set.end(), b);
+          std::swap(b.dist, b.set_dist);
+          b.set_sources = b.node_set.size();
+        } else {
+          start = add_node_set_sources(graph, CAP, b);
+        }
+        double dist = longest_path_from(graph, CAP, &start, &start + 1, b, path);
+        if (b.level_paths.size() <= searched)
+          b.level_paths.emplace_back();
+        b.level_paths[searched] = path;
+        b.level_dists.resize(searched + 1);
+        b.level_dists[searched] = dist;
+        ++searched;
+      } else {
+        path = b.level_paths[i];
+      }
+
+      if (b.level_dists[i] <= CAP / aspect)
+        break;
+
+      for (Vertex v : path) {
+        if (!b.in_node_set[v]) {
+          b.in_node_set[v] = true;
+          b.node_set.push_back(v);
+        }
+      }
+      ++found;
+    };
+  }
+
+  paths.resize(found);
+  return levels;
+}
+
+inline size_t find_distinct_paths(const CsrGraph &graph, double aspect,
+                                  double STEP, size_t k, SearchBuffers &b,
+                                  std::vector<std::vector<Vertex>> &paths) {
+  return find_distinct_paths(graph, aspect, STEP, k, b, paths,
+                             [] { return false; });
+}
+} // namespace csr
+
+#endif /* CSR_GRAPH_HPP */
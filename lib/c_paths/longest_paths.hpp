@@ -10,10 +10,15 @@
 #include <boost/graph/dijkstra_shortest_paths.hpp>
 
 #include <boost/functional/hash.hpp>
+#include <algorithm>
 #include <unordered_set>
 #include <vector>
 #include <iostream>
 
+// Thread safety: the path searches only read the graph they are given and
+// allocate their working memory per call, so concurrent searches on the same
+// Graph are safe. Building or modifying a graph is not synchronized.
+
 using namespace boost;
 
 namespace longest_paths {
@@ -28,9 +33,12 @@ namespace longest_paths {
     }
   };
 
+  // An edge of the skeleton. The ids of its endpoints are only read by the
+  // compressed graph of csr_graph.hpp, from_edges compares coordinates.
   struct Segment {
     Point src, trg;
     double weight, cap;
+    size_t src_id = 0, trg_id = 0;
   };
 }
 
@@ -46,14 +54,72 @@ using LGraph = labeled_graph<Graph, longest_paths::Point, hash_mapS>;
 template <class Type> using Predicate = std::function<bool(Type)>;
 using FGraph = filtered_graph<Graph, Predicate<Vertex>, Predicate<Edge>>;
 
-template <class Edges> Graph from_edges(const Edges &edges) {
-  LGraph lg;
-  for (auto e : edges) {
-    lg.add_vertex(e.src, e.src);
-    lg.add_vertex(e.trg, e.trg);
-    add_edge_by_label(e.src, e.trg, {e.weight, e.cap}, lg);
+// Memory reused by from_edges to identify equal edge endpoints
+struct GraphBuilder {
+  std::vector<std::pair<Node, size_t>> endpoints; // (point, 2 * edge + end)
+  std::vector<size_t> group_of;                   // endpoint -> point group
+  std::vector<size_t> group_first;                // group -> first endpoint
+  std::vector<Node> group_node;                   // group -> point
+  std::vector<size_t> order;                      // groups by first endpoint
+  std::vector<Vertex> vertex_of;                  // group -> vertex
+};
+
+// Builds the graph into g, reusing its memory and the memory of the builder.
+// Vertices are numbered in order of their first occurrence, exactly as with
+// the labeled graph of from_edges(edges).
+template <class Edges>
+void from_edges(const Edges &edges, Graph &g, GraphBuilder &b) {
+  b.endpoints.clear();
+  size_t i = 0;
+  for (const auto &e : edges) {
+    b.endpoints.emplace_back(e.src, 2 * i);
+    b.endpoints.emplace_back(e.trg, 2 * i + 1);
+    ++i;
+  }
+  std::sort(b.endpoints.begin(), b.endpoints.end(),
+            [](const auto &p, const auto &q) {
+              if (p.first.x != q.first.x)
+                return p.first.x < q.first.x;
+              if (p.first.y != q.first.y)
+                return p.first.y < q.first.y;
+              return p.second < q.second;
+            });
+
+  b.group_of.resize(b.endpoints.size());
+  b.group_first.clear();
+  b.group_node.clear();
+  for (size_t j = 0; j < b.endpoints.size(); ++j) {
+    if (j == 0 || !(b.endpoints[j].first == b.endpoints[j - 1].first)) {
+      b.group_first.push_back(b.endpoints[j].second);
+      b.group_node.push_back(b.endpoints[j].first);
+    }
+    b.group_of[b.endpoints[j].second] = b.group_first.size() - 1;
+  }
+
+  b.order.resize(b.group_first.size());
+  for (size_t j = 0; j < b.order.size(); ++j)
+    b.order[j] = j;
+  std::sort(b.order.begin(), b.order.end(), [&b](size_t x, size_t y) {
+    return b.group_first[x] < b.group_first[y];
+  });
+
+  g.clear();
+  b.vertex_of.resize(b.order.size());
+  for (size_t group : b.order)
+    b.vertex_of[group] = add_vertex(b.group_node[group], g);
+  i = 0;
+  for (const auto &e : edges) {
+    add_edge(b.vertex_of[b.group_of[2 * i]], b.vertex_of[b.group_of[2 * i + 1]],
+             {e.weight, e.cap}, g);
+    ++i;
   }
-  return lg.graph();
+}
+
+template <class Edges> Graph from_edges(const Edges &edges) {
+  Graph g;
+  GraphBuilder builder;
+  from_edges(edges, g, builder);
+  return g;
 }
 
 // returns a copy of the graph, only keeping edges with cap >= min_cap
@@ -111,9 +177,37 @@ std::vector<Vertex> component_vertices(Graph &g) {
   return representatives;
 }
 
+// Keeps the edges with cap >= min_cap. Used as a view on the graph instead of
+// copying it as filter_capacity does.
+struct CapacityFilter {
+  CapacityFilter() = default;
+  CapacityFilter(const Graph &g, double min_cap) : g(&g), min_cap(min_cap) {}
+  bool operator()(const Edge &e) const {
+    return get(edge_capacity, *g, e) >= min_cap;
+  }
+  const Graph *g = nullptr;
+  double min_cap = 0;
+};
+using CapGraph = filtered_graph<Graph, CapacityFilter>;
+
+// Working memory of the path searches. Passing the same buffers to repeated
+// searches lets them reuse their memory instead of reallocating it.
+struct PathSearchBuffers {
+  std::vector<Vertex> pred;
+  std::vector<double> dist;
+  std::vector<default_color_type> color;
+  std::vector<size_t> components;
+  std::vector<size_t> root;
+  std::vector<Vertex> representatives;
+  std::vector<Vertex> furthest;
+  std::vector<Vertex> node_set;
+  std::vector<char> in_node_set;
+  std::vector<Vertex> path1;
+};
+
 struct LastExaminedVisitor : public default_dijkstra_visitor {
   LastExaminedVisitor(Vertex *vd) : vd(vd) {}
-  void examine_vertex(Vertex v, const Graph &) { *vd = v; }
+  template <class G> void examine_vertex(Vertex v, const G &) { *vd = v; }
   Vertex *vd;
 };
 
@@ -139,7 +233,7 @@ struct LastRootedExaminedVisitor : public default_dijkstra_visitor {
   LastRootedExaminedVisitor(std::vector<Vertex> &cf, std::vector<size_t> &root,
                             std::vector<Vertex> &pred)
       : component_furthest(cf), root(root), pred(pred) {}
-  void examine_vertex(Vertex v, const Graph &) {
+  template <class G> void examine_vertex(Vertex v, const G &) {
     auto v_pred = pred[v];
     auto v_root = root[v_pred];
     root[v] = v_root;
@@ -150,29 +244,43 @@ struct LastRootedExaminedVisitor : public default_dijkstra_visitor {
   std::vector<Vertex> &pred;
 };
 
-template <class VertexIt>
-std::vector<Vertex> furthest_rooted_nodes(const Graph &g,
-                                          VertexIt vertices_begin,
-                                          VertexIt vertices_end) {
-  std::vector<Vertex> pred(num_vertices(g));
-  std::vector<double> dist(num_vertices(g));
-  std::vector<Vertex> component_furthest(vertices_begin, vertices_end);
-  std::vector<size_t> root(num_vertices(g));
+// Writes the vertex furthest from each of the given sources into furthest,
+// every vertex is attributed to its closest source.
+template <class G, class VertexIt>
+void furthest_rooted_nodes(const G &g, VertexIt vertices_begin,
+                           VertexIt vertices_end, PathSearchBuffers &b,
+                           std::vector<Vertex> &furthest) {
+  b.pred.resize(num_vertices(g));
+  b.dist.resize(num_vertices(g));
+  b.color.resize(num_vertices(g));
+  b.root.resize(num_vertices(g));
+  furthest.assign(vertices_begin, vertices_end);
 
   size_t i = 0;
   for (auto vit = vertices_begin; vit != vertices_end; ++vit, ++i) {
-    root[*vit] = i;
+    b.root[*vit] = i;
   }
 
   dijkstra_shortest_paths(
       g, vertices_begin, vertices_end,
-      make_iterator_property_map(pred.begin(), get(vertex_index, g)), // pred
-      make_iterator_property_map(dist.begin(), get(vertex_index, g)), // dist
-      get(edge_weight, g),                                            // weight
-      get(vertex_index, g),                                           //
+      make_iterator_property_map(b.pred.begin(), get(vertex_index, g)), // pred
+      make_iterator_property_map(b.dist.begin(), get(vertex_index, g)), // dist
+      get(edge_weight, g), // weight
+      get(vertex_index, g),
       std::less<double>(), closed_plus<double>(),                 // operations
       std::numeric_limits<double>::max(), 0.,                     // operations
-      LastRootedExaminedVisitor(component_furthest, root, pred)); // visitor
+      LastRootedExaminedVisitor(furthest, b.root, b.pred),        // visitor
+      make_iterator_property_map(b.color.begin(), get(vertex_index, g)));
+}
+
+template <class VertexIt>
+std::vector<Vertex> furthest_rooted_nodes(const Graph &g,
+                                          VertexIt vertices_begin,
+                                          VertexIt vertices_end) {
+  PathSearchBuffers buffers;
+  std::vector<Vertex> component_furthest;
+  furthest_rooted_nodes(g, vertices_begin, vertices_end, buffers,
+                        component_furthest);
   return component_furthest;
 }
 
@@ -182,53 +290,101 @@ std::vector<Vertex> furthest_rooted_nodes(const Graph &g,
 //  return furthest_node(g, &v, &v + 1);
 //}
 
+// Writes the furthest vertex of every connected component of g into
+// b.furthest (a vertex may occur more than once)
+template <class G>
+void component_furthest_vertices(const G &g, PathSearchBuffers &b) {
+  b.components.resize(num_vertices(g));
+  b.color.resize(num_vertices(g));
+  size_t num_components = connected_components(
+      g, make_iterator_property_map(b.components.begin(), get(vertex_index, g)),
+      color_map(make_iterator_property_map(b.color.begin(),
+                                           get(vertex_index, g))));
+  b.representatives.resize(num_components);
+  for (auto vertex : make_iterator_range(vertices(g))) {
+    b.representatives[b.components[vertex]] = vertex;
+  }
+  furthest_rooted_nodes(g, b.representatives.begin(), b.representatives.end(),
+                        b, b.furthest);
+}
+
 std::unordered_set<Vertex> component_furthest_vertices(Graph &g) {
-  auto vertices = component_vertices(g);
-  //  std::unordered_set<Vertex> furthest_vertices;
-  //  std::transform(vertices.begin(), vertices.end(),
-  //                 std::inserter(furthest_vertices, furthest_vertices.end()),
-  //                 [&g](Vertex v) { return furthest_node(g, v); });
-  auto furthest_vertices =
-      furthest_rooted_nodes(g, vertices.begin(), vertices.end());
-  return std::unordered_set<Vertex>(furthest_vertices.begin(),
-                                    furthest_vertices.end());
+  PathSearchBuffers buffers;
+  component_furthest_vertices(g, buffers);
+  return std::unordered_set<Vertex>(buffers.furthest.begin(),
+                                    buffers.furthest.end());
 }
 
-std::vector<Vertex> unpack_path(const std::vector<Vertex> &pred, Vertex v) {
-  std::vector<Vertex> path;
+void unpack_path(const std::vector<Vertex> &pred, Vertex v,
+                 std::vector<Vertex> &path) {
+  path.clear();
   path.push_back(v);
   while (pred[v] != v) {
     v = pred[v];
     path.push_back(v);
   }
+}
+
+std::vector<Vertex> unpack_path(const std::vector<Vertex> &pred, Vertex v) {
+  std::vector<Vertex> path;
+  unpack_path(pred, v, path);
   return path;
 }
 
+// Writes the path to the vertex furthest from the sources into path and
+// returns its length
 template <class G, class VertexIt>
-std::pair<double, std::vector<Vertex>>
-longest_path_from(const G &g, VertexIt vertices_begin, VertexIt vertices_end) {
-  std::vector<typename G::vertex_descriptor> pred(num_vertices(g));
-  std::vector<double> dist(num_vertices(g));
-  typename G::vertex_descriptor last_visited;
+double longest_path_from(const G &g, VertexIt vertices_begin,
+                         VertexIt vertices_end, PathSearchBuffers &b,
+                         std::vector<Vertex> &path) {
+  b.pred.resize(num_vertices(g));
+  b.dist.resize(num_vertices(g));
+  b.color.resize(num_vertices(g));
+  Vertex last_visited;
   dijkstra_shortest_paths(
       g, vertices_begin, vertices_end,
-      make_iterator_property_map(pred.begin(), get(vertex_index, g)), // pred
-      make_iterator_property_map(dist.begin(), get(vertex_index, g)), // dist
-      get(edge_weight, g),                                            // weight
-      get(vertex_index, g),                                           //
+      make_iterator_property_map(b.pred.begin(), get(vertex_index, g)), // pred
+      make_iterator_property_map(b.dist.begin(), get(vertex_index, g)), // dist
+      get(edge_weight, g), // weight
+      get(vertex_index, g),
       std::less<double>(), closed_plus<double>(), // operations
       std::numeric_limits<double>::max(), 0.,     // operations
-      LastExaminedVisitor(&last_visited));        // visitor
-  auto path = unpack_path(pred, last_visited);
-  auto path_dist = dist[last_visited];
+      LastExaminedVisitor(&last_visited),         // visitor
+      make_iterator_property_map(b.color.begin(), get(vertex_index, g)));
+  unpack_path(b.pred, last_visited, path);
+  return b.dist[last_visited];
+}
+
+template <class G, class VertexIt>
+std::pair<double, std::vector<Vertex>>
+longest_path_from(const G &g, VertexIt vertices_begin, VertexIt vertices_end) {
+  PathSearchBuffers buffers;
+  std::vector<Vertex> path;
+  double path_dist =
+      longest_path_from(g, vertices_begin, vertices_end, buffers, path);
   return {path_dist, path};
 }
 
-std::vector<std::vector<Vertex>>
-find_distinct_paths(Graph &graph, double aspect, double STEP, size_t k = 10) {
-  std::vector<std::vector<Vertex>> paths;
-  if (num_edges(graph) == 0)
-    return paths;
+// Writes up to k distinct long paths into paths, reusing the memory of paths
+// and of the buffers. Returns the number of capacity levels searched.
+// cancelled() is polled before every path search, once it returns true the
+// paths found so far are kept and the search stops.
+template <class Cancelled>
+size_t find_distinct_paths(const Graph &graph, double aspect, double STEP,
+                           size_t k, PathSearchBuffers &b,
+                           std::vector<std::vector<Vertex>> &paths,
+                           Cancelled cancelled) {
+  size_t found = 0;
+  auto add_path = [&]() -> std::vector<Vertex> & {
+    if (paths.size() <= found)
+      paths.emplace_back();
+    return paths[found];
+  };
+
+  if (num_edges(graph) == 0) {
+    paths.resize(0);
+    return 0;
+  }
 
   double mincap = get(edge_capacity, graph, *edges(graph).first);
   double maxcap = get(edge_capacity, graph, *edges(graph).first);
@@ -238,25 +394,63 @@ find_distinct_paths(Graph &graph, double aspect, double STEP, size_t k = 10) {
     maxcap = std::max(maxcap, cap);
   }
 
+  size_t levels = 0;
   for (double CAP = maxcap;
-       (CAP >= (mincap / STEP) || paths.size()==0) && paths.size() < k; CAP /= STEP) {
+       (CAP >= (mincap / STEP) || found == 0) && found < k; CAP /= STEP) {
+    ++levels;
+
+    CapGraph cap_graph(graph, CapacityFilter(graph, CAP));
+    component_furthest_vertices(cap_graph, b);
+
+    b.in_node_set.assign(num_vertices(graph), false);
+    b.node_set.clear();
+    for (Vertex v : b.furthest) {
+      if (!b.in_node_set[v]) {
+        b.in_node_set[v] = true;
+        b.node_set.push_back(v);
+      }
+    }
 
-    auto cap_graph = filter_capacity(graph, CAP);
-    auto node_set = component_furthest_vertices(cap_graph);
-    while (paths.size() < k) {
-      auto [dist1, path1] =
-          longest_path_from(cap_graph, node_set.begin(), node_set.end());
-      auto [dist, path] = 
-          longest_path_from(cap_graph, path1.begin(), path1.begin() + 1);
+    while (found < k) {
+      if (cancelled()) {
+        paths.resize(found);
+        return levels;
+      }
+      longest_path_from(cap_graph, b.node_set.begin(), b.node_set.end(), b,
+                        b.path1);
+      auto &path = add_path();
+      double dist = longest_path_from(cap_graph, b.path1.begin(),
+                                      b.path1.begin() + 1, b, path);
 
       if (dist <= CAP / aspect)
         break;
 
-      node_set.insert(path.begin(), path.end());
-      paths.push_back(path);
+      for (Vertex v : path) {
+        if (!b.in_node_set[v]) {
+          b.in_node_set[v] = true;
+          b.node_set.push_back(v);
+        }
+      }
+      ++found;
     };
   }
 
+  paths.resize(found);
+  return levels;
+}
+
+size_t find_distinct_paths(const Graph &graph, double aspect, double STEP,
+                           size_t k, PathSearchBuffers &b,
+                           std::vector<std::vector<Vertex>> &paths) {
+  return find_distinct_paths(graph, aspect, STEP, k, b, paths,
+                             [] { return false; });
+}
+
+std::vector<std::vector<Vertex>>
+find_distinct_paths(Graph &graph, double aspect, double STEP, size_t k = 10) {
+  PathSearchBuffers buffers;
+  std::vector<std::vector<Vertex>> paths;
+  find_distinct_paths(graph, aspect, STEP, k, buffers, paths);
   return paths;
 }
 
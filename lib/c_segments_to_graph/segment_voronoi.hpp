@@ -0,0 +1,217 @@
+#ifndef SEGMENT_VORONOI_HPP
+#define SEGMENT_VORONOI_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <map>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include <CGAL/Segment_Delaunay_graph_2.h>
+#include <CGAL/Segment_Delaunay_graph_filtered_traits_2.h>
+#include <CGAL/Simple_cartesian.h>
+#include <CGAL/Unique_hash_map.h>
+
+#include "segments_to_graph.hpp"
+
+// Skeleton extraction from the Voronoi diagram of the boundary segments
+// (CGAL's segment Delaunay graph). Unlike the conforming CDT of
+// segments_to_graph.hpp it needs no subsampling: the skeleton edges are the
+// edges of the medial axis of the polygon, parabolic arcs are replaced by
+// their chords. Thread safety: every call builds its own diagram.
+
+namespace segment_voronoi {
+using CK = CGAL::Simple_cartesian<double>;
+using Gt =
+    CGAL::Segment_Delaunay_graph_filtered_traits_2<CK, CGAL::Field_with_sqrt_tag>;
+using SDG = CGAL::Segment_Delaunay_graph_2<Gt>;
+using Site = SDG::Site_2;
+using CPoint = CK::Point_2;
+
+// Neighbours of a boundary vertex in its ring, oriented to have the polygon
+// interior on the left
+struct Corner {
+  CPoint prev, next;
+};
+// The corners by their coordinates. Rings touching in a vertex, or a ring
+// touching itself, have several corners there.
+using Corners = std::multimap<std::pair<double, double>, Corner>;
+
+inline std::pair<double, double> key(const CPoint &p) { return {p.x(), p.y()}; }
+
+inline double signed_area(const std::vector<CPoint> &ring) {
+  double area = 0;
+  for (size_t i = 0; i < ring.size(); i++) {
+    const CPoint &a = ring[i];
+    const CPoint &b = ring[(i + 1) % ring.size()];
+    area += a.x() * b.y() - b.x() * a.y();
+  }
+  return area / 2;
+}
+
+// true if x lies in the interior wedge of the corner c at p
+inline bool in_wedge(const Corner &c, const CPoint &p, const CPoint &x) {
+  bool left_of_prev = CGAL::orientation(c.prev, p, x) == CGAL::LEFT_TURN;
+  bool left_of_next = CGAL::orientation(p, c.next, x) == CGAL::LEFT_TURN;
+  if (CGAL::orientation(c.prev, p, c.next) == CGAL::RIGHT_TURN)
+    return left_of_prev || left_of_next;
+  return left_of_prev && left_of_next;
+}
+
+// true if x lies on the interior side of the boundary at the site. Sites
+// created at crossings of the rings are not part of a ring and never have an
+// interior side.
+inline bool on_interior_side(const Site &s, const CPoint &x,
+                             const Corners &corners) {
+  if (s.is_segment()) {
+    CPoint a = s.source_of_supporting_site();
+    CPoint b = s.target_of_supporting_site();
+    // The corner of the ring the segment belongs to tells its orientation
+    auto range = corners.equal_range(key(a));
+    for (auto it = range.first; it != range.second; ++it) {
+      if (it->second.next == b)
+        return CGAL::orientation(a, b, x) == CGAL::LEFT_TURN;
+      if (it->second.prev == b)
+        return CGAL::orientation(b, a, x) == CGAL::LEFT_TURN;
+    }
+    return false;
+  }
+  // The interior wedges of the corners at a shared vertex do not overlap
+  auto range = corners.equal_range(key(s.point()));
+  return std::any_of(range.first, range.second, [&](const auto &corner) {
+    return in_wedge(corner.second, s.point(), x);
+  });
+}
+
+inline bool is_endpoint(const Site &p, const Site &s) {
+  return p.is_point() && s.is_segment() &&
+         (p.point() == s.source() || p.point() == s.target());
+}
+
+inline double squared_distance_to(const Site &s, const CPoint &x) {
+  return s.is_point() ? CGAL::squared_distance(x, s.point())
+                      : CGAL::squared_distance(x, s.segment());
+}
+
+// Smallest distance to the sites s and t along their Voronoi edge p -> q
+inline double clearance(const Site &s, const Site &t, const CPoint &p,
+                        const CPoint &q) {
+  if (s.is_point() && t.is_point()) {
+    // A straight bisector, closest to the sites where it crosses the segment
+    // between them
+    return std::sqrt(CGAL::squared_distance(s.point(), CK::Segment_2(p, q)));
+  }
+  // Between two segments the distance changes linearly along the bisector
+  double d = std::sqrt(std::min(squared_distance_to(s, p),
+                                squared_distance_to(s, q)));
+  if (s.is_point() != t.is_point()) {
+    // A parabolic arc, whose distance to its focus grows with the distance
+    // from the apex along the directrix
+    const CPoint &focus = s.is_point() ? s.point() : t.point();
+    CK::Line_2 directrix = (s.is_point() ? t : s).segment().supporting_line();
+    CK::Vector_2 dir = directrix.to_vector();
+    double tf = dir * (focus - CGAL::ORIGIN);
+    double tp = dir * (p - CGAL::ORIGIN);
+    double tq = dir * (q - CGAL::ORIGIN);
+    if (std::min(tp, tq) <= tf && tf <= std::max(tp, tq))
+      d = std::min(d, std::sqrt(CGAL::squared_distance(focus, directrix)) / 2);
+  }
+  return d;
+}
+
+// Writes the skeleton edges of the polygon given by its rings, the outer
+// boundary first, into skeleton_edges, reusing its memory. The orientation
+// of the rings does not matter. Returns the largest clearance of a skeleton
+// vertex, which is the radius of the largest circle inside of the polygon.
+// cancelled() is polled between the insertions and between the edges, once
+// it returns true the computation stops and std::nullopt is returned.
+template <class Cancelled>
+std::optional<double>
+compute_skeleton_edges(const std::vector<std::vector<Point>> &rings,
+                       std::vector<SkeletonEdge> &skeleton_edges,
+                       Cancelled cancelled) {
+  skeleton_edges.clear();
+  SDG sdg;
+  Corners corners;
+  std::vector<CPoint> ring;
+  for (size_t r = 0; r < rings.size(); r++) {
+    ring.clear();
+    for (const Point &p : rings[r]) {
+      CPoint c(p.x(), p.y());
+      if (ring.empty() || ring.back() != c)
+        ring.push_back(c);
+    }
+    while (ring.size() > 1 && ring.front() == ring.back())
+      ring.pop_back();
+    if (ring.size() < 3)
+      continue;
+    // The interior is left of a counterclockwise outer boundary and of
+    // clockwise holes
+    if ((signed_area(ring) < 0) == (r == 0))
+      std::reverse(ring.begin(), ring.end());
+
+    for (size_t i = 0; i < ring.size(); i++) {
+      if (cancelled())
+        return std::nullopt;
+      const CPoint &prev = ring[(i + ring.size() - 1) % ring.size()];
+      const CPoint &next = ring[(i + 1) % ring.size()];
+      corners.insert({key(ring[i]), Corner{prev, next}});
+      sdg.insert(ring[i], next);
+    }
+  }
+
+  // The faces are the Voronoi vertices, numbered as they are met
+  const size_t none = std::numeric_limits<size_t>::max();
+  CGAL::Unique_hash_map<SDG::Face_handle, size_t> face_ids(none);
+  SkeletonVertexIds ids;
+  auto id_of = [&](SDG::Face_handle f) {
+    size_t &id = face_ids[f];
+    if (id == none)
+      id = ids.add();
+    return id;
+  };
+
+  // The dual of a Delaunay edge between two sites is a skeleton edge if it
+  // is bounded, lies inside of the polygon and does not separate a segment
+  // from its own endpoint. These perpendiculars end on the boundary and
+  // are not part of the medial axis. A Voronoi edge touches the boundary at
+  // most in its endpoints, so the midpoint decides on which side it lies.
+  double max_clearance = 0;
+  for (auto eit = sdg.finite_edges_begin(); eit != sdg.finite_edges_end();
+       ++eit) {
+    if (cancelled())
+      return std::nullopt;
+    auto f = eit->first;
+    int i = eit->second;
+    auto n = f->neighbor(i);
+    if (sdg.is_infinite(f) || sdg.is_infinite(n))
+      continue;
+    const Site &s = f->vertex((i + 1) % 3)->site();
+    const Site &t = f->vertex((i + 2) % 3)->site();
+    if (is_endpoint(s, t) || is_endpoint(t, s))
+      continue;
+
+    CPoint p = sdg.primal(f);
+    CPoint q = sdg.primal(n);
+    if (p == q) {
+      ids.unite(id_of(f), id_of(n));
+      continue;
+    }
+    if (!on_interior_side(s.is_segment() ? s : t, CGAL::midpoint(p, q),
+                          corners))
+      continue;
+
+    max_clearance = std::max({max_clearance,
+                              std::sqrt(squared_distance_to(s, p)),
+                              std::sqrt(squared_distance_to(s, q))});
+    skeleton_edges.push_back({Point(p.x(), p.y()), Point(q.x(), q.y()),
+                              clearance(s, t, p, q), id_of(f), id_of(n)});
+  }
+  ids.relabel(skeleton_edges);
+  return max_clearance;
+}
+} // namespace segment_voronoi
+
+#endif /* SEGMENT_VORONOI_HPP */
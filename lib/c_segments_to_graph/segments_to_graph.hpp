@@ -5,17 +5,46 @@
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <stdexcept>
-#include <unordered_set>
 #include <vector>
 
 #include <CGAL/Constrained_Delaunay_triangulation_2.h>
+#include <CGAL/Constrained_triangulation_face_base_2.h>
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/Triangulation_conformer_2.h>
+#include <CGAL/Triangulation_data_structure_2.h>
+#include <CGAL/Triangulation_face_base_with_info_2.h>
+#include <CGAL/Triangulation_vertex_base_2.h>
+
+// Thread safety: compute_skeleton_edges inserts Steiner points into the CDT it
+// is given and writes the face infos, so every thread needs its own
+// triangulation and its own SkeletonBuffers. No other state is shared between
+// calls.
 
 using K = CGAL::Exact_predicates_inexact_constructions_kernel;
+
+// Per face data of the skeleton extraction, only valid within
+// compute_skeleton_edges
+struct FaceInfo {
+  // Number of constraints crossed on the way from the infinite face. The
+  // polygon interior has odd levels, the outside and the holes even ones.
+  int nesting_level = -1;
+  // Circumcenter and squared circumradius of finite faces
+  K::Point_2 center;
+  double squared_radius = 0;
+  // Number of the face among the faces of the domain
+  size_t id = 0;
+
+  bool in_domain() const { return nesting_level % 2 == 1; }
+};
+
 using Itag = CGAL::Exact_predicates_tag;
-using CDT = CGAL::Constrained_Delaunay_triangulation_2<K, CGAL::Default, Itag>;
+using Vb = CGAL::Triangulation_vertex_base_2<K>;
+using Fb = CGAL::Constrained_triangulation_face_base_2<
+    K, CGAL::Triangulation_face_base_with_info_2<FaceInfo, K>>;
+using TDS = CGAL::Triangulation_data_structure_2<Vb, Fb>;
+using CDT = CGAL::Constrained_Delaunay_triangulation_2<K, TDS, Itag>;
 using FH = CDT::Face_handle;
 using VH = CDT::Vertex_handle;
 
@@ -23,11 +52,67 @@ using Point = CDT::Point;
 using Segment = K::Segment_2;
 using Line = K::Line_2;
 
+// A skeleton edge from p to q with clearance d. Endpoints with the same id
+// are the same skeleton vertex, the ids are numbers of Voronoi vertices
+// (faces of the triangulation), so the graph can be built without
+// comparing coordinates.
 struct SkeletonEdge {
   Point p, q;
   double d;
+  size_t p_id = 0, q_id = 0;
+};
+
+// Union-find over the ids of the Voronoi vertices. Neighbouring faces with
+// the same circumcenter (cocircular points) are one skeleton vertex.
+struct SkeletonVertexIds {
+  std::vector<size_t> parent;
+
+  void clear() { parent.clear(); }
+  size_t add() {
+    parent.push_back(parent.size());
+    return parent.back();
+  }
+  size_t find(size_t id) {
+    while (parent[id] != id) {
+      parent[id] = parent[parent[id]];
+      id = parent[id];
+    }
+    return id;
+  }
+  void unite(size_t a, size_t b) {
+    a = find(a);
+    b = find(b);
+    parent[std::max(a, b)] = std::min(a, b);
+  }
+  // Replaces the ids of the edge endpoints by their representatives
+  void relabel(std::vector<SkeletonEdge> &edges) {
+    for (auto &e : edges) {
+      e.p_id = find(e.p_id);
+      e.q_id = find(e.q_id);
+    }
+  }
+};
+
+// Buffers of compute_skeleton_edges, kept between calls to reuse their memory
+struct SkeletonBuffers {
+  // Flood fill of mark_domains
+  std::vector<FH> stack;
+  std::vector<CDT::Edge> border;
+  SkeletonVertexIds ids;
 };
 
+// Removes all vertices and faces of cdt for the next triangulation. The
+// storage of the largest triangulation so far is reserved again in one block
+// each, the faces and vertices are created in the same order as in a new CDT,
+// which keeps the results independent of the earlier triangulations.
+inline void clear_keeping_storage(CDT &cdt) {
+  size_t vertices = cdt.tds().vertices().capacity();
+  size_t faces = cdt.tds().faces().capacity();
+  cdt.clear();
+  cdt.tds().vertices().reserve(vertices);
+  cdt.tds().faces().reserve(faces);
+}
+
 std::vector<Segment> read_segments() {
   std::vector<Segment> segments;
   std::copy(std::istream_iterator<Segment>(std::cin),
@@ -35,119 +120,182 @@ std::vector<Segment> read_segments() {
   return segments;
 }
 
-FH find_inner_face(const CDT &cdt) {
-  std::vector<FH> queue;
-  std::unordered_set<FH> settled;
-  queue.push_back(cdt.infinite_face());
-  while (!queue.empty()) {
-    auto fh = queue.back();
-    queue.pop_back();
-    if (settled.count(fh) > 0) // already visited ?
-      continue;
-    settled.insert(fh);
-    for (int i = 0; i < 3; i++) {
-      CDT::Edge e(fh, i);
-      if (cdt.is_constrained(e)) {
-        auto inner_face = e.first->neighbor(e.second);
-        return inner_face;
-      }
-      CDT::Face_handle n = fh->neighbor(i);
-      if (settled.count(n) > 0)
+// Sets the nesting level of every face by a flood fill from the infinite
+// face, which only crosses a constraint to enter the next level.
+inline void mark_domains(CDT &cdt, SkeletonBuffers &buffers) {
+  for (auto fit = cdt.all_faces_begin(); fit != cdt.all_faces_end(); ++fit)
+    fit->info().nesting_level = -1;
+
+  auto &stack = buffers.stack;
+  // Faces behind a constraint of the levels filled so far, the next level
+  // starts from them
+  auto &border = buffers.border;
+  stack.clear();
+  border.clear();
+  size_t next_border = 0;
+  auto fill = [&](FH start, int level) {
+    stack.push_back(start);
+    while (!stack.empty()) {
+      FH fh = stack.back();
+      stack.pop_back();
+      if (fh->info().nesting_level != -1)
         continue;
-      queue.push_back(n);
+      fh->info().nesting_level = level;
+      for (int i = 0; i < 3; i++) {
+        FH n = fh->neighbor(i);
+        if (n->info().nesting_level != -1)
+          continue;
+        if (cdt.is_constrained(CDT::Edge(fh, i)))
+          border.push_back(CDT::Edge(fh, i));
+        else
+          stack.push_back(n);
+      }
     }
+  };
+
+  fill(cdt.infinite_face(), 0);
+  while (next_border < border.size()) {
+    CDT::Edge e = border[next_border++];
+    FH n = e.first->neighbor(e.second);
+    if (n->info().nesting_level == -1)
+      fill(n, e.first->info().nesting_level + 1);
   }
 }
 
-std::unordered_set<CDT::Face_handle> find_all_inner_faces(const CDT &cdt) {
-  auto init_fh = find_inner_face(cdt);
-  std::vector<CDT::Face_handle> queue;
-  std::unordered_set<FH> settled;
-  queue.push_back(init_fh);
-  while (!queue.empty()) {
-    auto fh = queue.back();
-    queue.pop_back();
-    if (settled.count(fh) > 0)
+inline void mark_domains(CDT &cdt) {
+  SkeletonBuffers buffers;
+  mark_domains(cdt, buffers);
+}
+
+// Index of an edge of the finite face f which has to strictly on its outer
+// side, preferring one crossed by the segment from -> to. -1 if to lies in
+// the closed face.
+inline int exit_edge(FH f, const Point &from, const Point &to) {
+  int beyond = -1;
+  for (int i = 0; i < 3; i++) {
+    const Point &a = f->vertex(CDT::ccw(i))->point();
+    const Point &b = f->vertex(CDT::cw(i))->point();
+    if (CGAL::orientation(a, b, to) != CGAL::RIGHT_TURN)
       continue;
-    settled.insert(fh);
-    for (int i = 0; i < 3; i++) {
-      CDT::Edge e(fh, i);
-      if (cdt.is_constrained(e)) {
-        continue; // stay inside polygon
-      }
-      CDT::Face_handle n = fh->neighbor(i);
-      if (settled.count(n) > 0)
-        continue;
-      queue.push_back(n);
-    }
+    auto oa = CGAL::orientation(from, to, a);
+    auto ob = CGAL::orientation(from, to, b);
+    if (oa != ob || oa == CGAL::COLLINEAR)
+      return i;
+    beyond = i;
   }
-  return settled;
+  return beyond;
 }
 
-std::vector<SkeletonEdge> compute_skeleton_edges(CDT &cdt) {
-  CGAL::make_conforming_Delaunay_2(cdt);
+// Walks through adjacent faces from f, which contains from, along the
+// segment from -> to and returns the face containing to. Returns nothing if
+// the walk leaves the convex hull or, with domain_only, passes a face
+// outside the domain. Passing from = to gives a visibility walk, which
+// terminates on Delaunay triangulations.
+inline std::optional<FH> walk(const CDT &cdt, FH f, const Point &from,
+                              const Point &to, bool domain_only) {
+  // A guard against cycling in degenerate configurations
+  for (size_t steps = 0; steps <= cdt.number_of_faces(); ++steps) {
+    if (cdt.is_infinite(f) || (domain_only && !f->info().in_domain()))
+      return std::nullopt;
+    int i = exit_edge(f, from, to);
+    if (i < 0)
+      return f;
+    f = f->neighbor(i);
+  }
+  return std::nullopt;
+}
 
-  auto inner_faces = find_all_inner_faces(cdt);
-  std::vector<SkeletonEdge> skeleton_edges;
+// Writes the skeleton edges into skeleton_edges, reusing its memory and the
+// one of buffers. Returns the number of Steiner points added to make the CDT conforming.
+// cancelled() is polled between the conforming steps and between the edges,
+// once it returns true the computation stops and std::nullopt is returned.
+template <class Cancelled>
+std::optional<size_t>
+compute_skeleton_edges(CDT &cdt, std::vector<SkeletonEdge> &skeleton_edges,
+                       SkeletonBuffers &buffers, Cancelled cancelled) {
+  size_t input_vertices = cdt.number_of_vertices();
+  // Same as CGAL::make_conforming_Delaunay_2, but interruptible
+  CGAL::Triangulation_conformer_2<CDT> conformer(cdt);
+  conformer.init_Delaunay();
+  while (conformer.step_by_step_conforming_Delaunay()) {
+    if (cancelled())
+      return std::nullopt;
+  }
+  size_t steiner_points = cdt.number_of_vertices() - input_vertices;
 
+  mark_domains(cdt, buffers);
+  auto &ids = buffers.ids;
+  ids.clear();
+  for (auto fit = cdt.finite_faces_begin(); fit != cdt.finite_faces_end();
+       ++fit) {
+    if (!fit->info().in_domain())
+      continue;
+    fit->info().id = ids.add();
+    fit->info().center = cdt.circumcenter(fit);
+    fit->info().squared_radius =
+        CGAL::squared_distance(fit->info().center, fit->vertex(0)->point());
+  }
+  skeleton_edges.clear();
+
+  // The dual of an edge between two faces of the domain is a skeleton edge
+  // if the segment between their circumcenters stays in the domain. It is
+  // checked by walking from the faces of the edge, which are close to the
+  // circumcenters as the triangulation is Delaunay.
   for (auto eit = cdt.finite_edges_begin(); eit != cdt.finite_edges_end();
        ++eit) {
+    if (cancelled())
+      return std::nullopt;
     if (cdt.is_constrained(*eit))
       continue;
-    auto e_1 = *eit;
-    auto f_1 = e_1.first;
-    if (cdt.is_infinite(f_1))
+    // Faces on both sides of an unconstrained edge share their nesting level
+    auto f_1 = eit->first;
+    auto f_2 = f_1->neighbor(eit->second);
+    if (cdt.is_infinite(f_1) || cdt.is_infinite(f_2) ||
+        !f_1->info().in_domain())
       continue;
-    Point c_1;
-    c_1 = cdt.circumcenter(f_1);
-    auto r_1 = CGAL::squared_distance(c_1, f_1->vertex(0)->point());
-
-    auto e_2 = cdt.mirror_edge(*eit);
-    auto f_2 = e_2.first;
-    if (cdt.is_infinite(f_2))
+    const Point &c_1 = f_1->info().center;
+    const Point &c_2 = f_2->info().center;
+    if (c_1 == c_2) {
+      ids.unite(f_1->info().id, f_2->info().id);
       continue;
-    Point c_2;
-    c_2 = cdt.circumcenter(f_2);
-    auto r_2 = CGAL::squared_distance(c_2, f_2->vertex(0)->point());
+    }
 
     auto s = cdt.segment(*eit);
     auto l = Line(s);
 
     double clearing;
     if (l.oriented_side(c_1) == l.oriented_side(c_2)) {
-      clearing = std::sqrt(std::min(r_1, r_2));
+      clearing = std::sqrt(std::min(f_1->info().squared_radius,
+                                    f_2->info().squared_radius));
     } else {
       clearing = std::sqrt(s.squared_length()) / 2.;
     }
 
-    if (c_1 == c_2)
-      continue;
-
-    CDT::Locate_type loc;
-    int loci;
-    auto fc1 = cdt.locate(c_1, loc, loci, f_1);
-    if (cdt.is_infinite(fc1))
-      continue;
-    auto fc2 = cdt.locate(c_2, loc, loci, f_2);
-    if (cdt.is_infinite(fc2))
-      continue;
+    auto fc1 = walk(cdt, f_1, c_1, c_1, false);
+    if (fc1 && walk(cdt, *fc1, c_1, c_2, true))
+      skeleton_edges.push_back(
+          {c_1, c_2, clearing, f_1->info().id, f_2->info().id});
+  }
+  ids.relabel(skeleton_edges);
+  return steiner_points;
+}
 
-    auto face_circulator = cdt.line_walk(c_1, c_2, fc1);
-    if (face_circulator.is_empty())
-      continue;
+template <class Cancelled>
+std::optional<size_t>
+compute_skeleton_edges(CDT &cdt, std::vector<SkeletonEdge> &skeleton_edges,
+                       Cancelled cancelled) {
+  SkeletonBuffers buffers;
+  return compute_skeleton_edges(cdt, skeleton_edges, buffers, cancelled);
+}
 
-    std::vector<FH> faces;
-    faces.push_back(face_circulator.handle());
-    while (cdt.triangle(face_circulator.handle()).has_on_unbounded_side(c_2)) {
-      ++face_circulator;
-      faces.push_back(face_circulator.handle());
-    }
-    if (std::none_of(faces.begin(), faces.end(), [&inner_faces](FH h) {
-          return inner_faces.count(h) == 0;
-        }))
-      skeleton_edges.push_back({c_1, c_2, clearing});
-  }
+size_t compute_skeleton_edges(CDT &cdt,
+                              std::vector<SkeletonEdge> &skeleton_edges) {
+  return *compute_skeleton_edges(cdt, skeleton_edges, [] { return false; });
+}
 
+std::vector<SkeletonEdge> compute_skeleton_edges(CDT &cdt) {
+  std::vector<SkeletonEdge> skeleton_edges;
+  compute_skeleton_edges(cdt, skeleton_edges);
   return skeleton_edges;
 }
 
@@ -0,0 +1,500 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "labelcorpus.h"
+#include "liblabeling.h"
+
+#include "corpus.hpp"
+#include "record_stream.hpp"
+#include "stages.hpp"
+#include "suite.hpp"
+
+using std::cout;
+using std::endl;
+
+using Clock = std::chrono::steady_clock;
+
+// Counts every heap allocation of the process, including the library's
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    ++allocations;
+    if(void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    // Throughput of computeLabels for increasing worker counts
+    void scaling(size_t count, size_t maxThreads) {
+        auto polygons = bench::polygons(count);
+        std::vector<liblabel::LabelJob> jobs;
+        for(const auto& poly : polygons) {
+            jobs.push_back({0.2, &poly});
+        }
+
+        std::vector<size_t> threadCounts;
+        for(size_t t = 1; t < maxThreads; t *= 2) {
+            threadCounts.push_back(t);
+        }
+        threadCounts.push_back(maxThreads);
+
+        cout << "Labeling " << jobs.size() << " polygons" << endl;
+        cout << std::setw(8) << "threads" << std::setw(14) << "seconds"
+             << std::setw(14) << "labels/s" << std::setw(10) << "speedup"
+             << std::setw(12) << "efficiency" << endl;
+
+        double serial = 0;
+        for(size_t threads : threadCounts) {
+            auto start = Clock::now();
+            auto results = liblabel::computeLabels(jobs, {threads});
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            if(threads == 1) serial = seconds;
+
+            cout << std::fixed << std::setprecision(3)
+                 << std::setw(8) << threads << std::setw(14) << seconds
+                 << std::setw(14) << jobs.size() / seconds
+                 << std::setw(10) << serial / seconds
+                 << std::setw(12) << serial / seconds / threads << endl;
+        }
+    }
+
+    // Heap allocations per label with and without a reused workspace
+    void allocs(size_t count) {
+        auto polygons = bench::polygons(count);
+
+        size_t before = allocations;
+        for(const auto& poly : polygons) {
+            liblabel::computeLabel(0.2, poly);
+        }
+        double fresh = double(allocations - before) / polygons.size();
+
+        liblabel::LabelingWorkspace workspace;
+        for(const auto& poly : polygons) {
+            liblabel::computeLabel(0.2, poly, workspace);
+        }
+        before = allocations;
+        for(const auto& poly : polygons) {
+            liblabel::computeLabel(0.2, poly, workspace);
+        }
+        double reused = double(allocations - before) / polygons.size();
+
+        cout << "Allocations per label over " << polygons.size() << " polygons" << endl;
+        cout << std::fixed << std::setprecision(1)
+             << "without workspace:\t" << fresh << "\n"
+             << "with warm workspace:\t" << reused << endl;
+    }
+
+    double labelHeight(const liblabel::AreaLabel& l) {
+        return l.rad_upper - l.rad_lower;
+    }
+
+    using Variant = std::pair<std::string, liblabel::Config>;
+
+    // A column of compareVariants next to the time, e.g. the time of a
+    // stage or the size of the skeleton, averaged over the polygons
+    struct Column {
+        std::string name;
+        int precision;
+        std::function<double(const liblabel::LabelStats&)> value;
+    };
+
+    // Time and label quality of configuration variants over the corpus and
+    // three synthetic polygons. The time of a label and the columns are the
+    // smallest values over the repetitions, the quality of a label is its
+    // height relative to the label of the reference configuration.
+    void compareVariants(const std::string& title, size_t repetitions, const Variant& reference,
+                         const std::vector<Variant>& variants, const std::vector<Column>& columns = {}) {
+        auto records = bench::loadCorpus();
+        std::mt19937 rng(7);
+        for(size_t n : {100, 1000, 5000}) {
+            records.push_back({"synthetic_" + std::to_string(n), 0.2, bench::syntheticPolygon(n, rng)});
+        }
+
+        liblabel::LabelingWorkspace workspace;
+        std::vector<std::optional<liblabel::AreaLabel>> referenceLabels;
+        for(const auto& record : records) {
+            referenceLabels.push_back(liblabel::computeLabel(record.aspect, record.polygon, workspace, false,
+                                                             reference.second));
+        }
+
+        int nameWidth = 10;
+        for(const auto& variant : variants) {
+            nameWidth = std::max(nameWidth, int(variant.first.size()) + 2);
+        }
+        cout << title << " over " << records.size() << " polygons, quality relative to "
+             << reference.first << endl;
+        cout << std::left << std::setw(nameWidth) << "variant" << std::right << std::setw(12) << "ms/label";
+        for(const auto& column : columns) {
+            cout << std::setw(column.name.size() + 3) << column.name;
+        }
+        cout << std::setw(14) << "mean quality" << std::setw(13) << "min quality"
+             << std::setw(11) << "differing" << std::setw(10) << "missing" << endl;
+
+        for(const auto& [name, config] : variants) {
+            double seconds = 0, quality = 0, minQuality = INFINITY;
+            size_t compared = 0, differing = 0, missing = 0;
+            std::vector<double> sums(columns.size(), 0);
+            for(size_t i = 0; i < records.size(); ++i) {
+                double best = INFINITY;
+                std::vector<double> values(columns.size(), INFINITY);
+                std::optional<liblabel::AreaLabel> label;
+                liblabel::LabelStats stats;
+                for(size_t r = 0; r < repetitions; ++r) {
+                    auto start = Clock::now();
+                    label = liblabel::computeLabel(records[i].aspect, records[i].polygon, workspace, false, config, &stats);
+                    best = std::min(best, std::chrono::duration<double>(Clock::now() - start).count());
+                    for(size_t c = 0; c < columns.size(); ++c) {
+                        values[c] = std::min(values[c], columns[c].value(stats));
+                    }
+                }
+                seconds += best;
+                for(size_t c = 0; c < columns.size(); ++c) {
+                    sums[c] += values[c];
+                }
+                const auto& expected = referenceLabels[i];
+                if(label.has_value() != expected.has_value()
+                   || (label.has_value() && labelHeight(*label) != labelHeight(*expected))) {
+                    ++differing;
+                }
+                if(!label.has_value()) {
+                    ++missing;
+                } else if(expected.has_value()) {
+                    double q = labelHeight(*label) / labelHeight(*expected);
+                    quality += q;
+                    minQuality = std::min(minQuality, q);
+                    ++compared;
+                }
+            }
+
+            double n = records.size();
+            cout << std::left << std::setw(nameWidth) << name << std::right << std::fixed
+                 << std::setprecision(3) << std::setw(12) << 1000 * seconds / n;
+            for(size_t c = 0; c < columns.size(); ++c) {
+                cout << std::setprecision(columns[c].precision) << std::setw(columns[c].name.size() + 3)
+                     << sums[c] / n;
+            }
+            cout << std::setprecision(3) << std::setw(14) << (compared ? quality / compared : 0)
+                 << std::setw(13) << (compared ? minQuality : 0)
+                 << std::setw(11) << differing << std::setw(10) << missing << endl;
+        }
+        cout << std::defaultfloat;
+    }
+
+    // Time and quality of the subsampling variants against a dense uniform
+    // sampling
+    void subsampling(size_t repetitions) {
+        using Sampling = liblabel::Config::Sampling;
+        auto config = [](size_t budget, Sampling sampling, double tolerance) {
+            liblabel::Config c;
+            c.vertexBudget = budget;
+            c.sampling = sampling;
+            c.simplifyTolerance = tolerance;
+            return c;
+        };
+        compareVariants("Subsampling variants", repetitions, {"uniform 400", config(400, Sampling::Uniform, 0)}, {
+            {"uniform 50", config(50, Sampling::Uniform, 0)},
+            {"uniform 100", config(100, Sampling::Uniform, 0)},
+            {"uniform 200", config(200, Sampling::Uniform, 0)},
+            {"adaptive 50", config(50, Sampling::Adaptive, 0)},
+            {"adaptive 100", config(100, Sampling::Adaptive, 0)},
+            {"uniform 100 simplified", config(100, Sampling::Uniform, 0.5)},
+            {"adaptive 100 simplified", config(100, Sampling::Adaptive, 0.5)},
+        }, {
+            {"vertices", 0, [](const liblabel::LabelStats& s) { return double(s.sampledVertices); }},
+        });
+    }
+
+    // Time, size and label quality of the skeleton backends against the CDT
+    // of a dense uniform sampling
+    void backends(size_t repetitions) {
+        using Skeleton = liblabel::Config::Skeleton;
+        using Sampling = liblabel::Config::Sampling;
+        auto config = [](Skeleton skeleton, size_t budget, Sampling sampling) {
+            liblabel::Config c;
+            c.skeleton = skeleton;
+            c.vertexBudget = budget;
+            c.sampling = sampling;
+            return c;
+        };
+        Variant reference = {"cdt uniform 400", config(Skeleton::ConformingCDT, 400, Sampling::Uniform)};
+        compareVariants("Skeleton backends", repetitions, reference, {
+            {"cdt uniform 100", config(Skeleton::ConformingCDT, 100, Sampling::Uniform)},
+            {"cdt adaptive 100", config(Skeleton::ConformingCDT, 100, Sampling::Adaptive)},
+            reference,
+            {"segment voronoi", config(Skeleton::SegmentVoronoi, 100, Sampling::Uniform)},
+        }, {
+            {"skeleton ms", 3, [](const liblabel::LabelStats& s) { return 1000 * s.skeletonSeconds; }},
+            {"vertices", 0, [](const liblabel::LabelStats& s) { return double(s.sampledVertices); }},
+            {"steiner", 0, [](const liblabel::LabelStats& s) { return double(s.steinerPoints); }},
+            {"edges", 0, [](const liblabel::LabelStats& s) { return double(s.skeletonEdges); }},
+        });
+    }
+
+    // Time of the path evaluation per kernel and how often the fast kernel
+    // places a label differently than the exact predicates
+    void kernels(size_t repetitions) {
+        using Kernel = liblabel::Config::Kernel;
+        auto config = [](Kernel kernel) {
+            liblabel::Config c;
+            c.kernel = kernel;
+            return c;
+        };
+        Variant reference = {"exact predicates", config(Kernel::ExactPredicates)};
+        compareVariants("Kernels of the path evaluation", repetitions, reference, {
+            reference,
+            {"fast", config(Kernel::Fast)},
+        }, {
+            {"evaluation ms", 3, [](const liblabel::LabelStats& s) { return 1000 * s.evaluationSeconds; }},
+            {"cups", 0, [](const liblabel::LabelStats& s) { return double(s.cups); }},
+        });
+    }
+
+    // Time of the path search and label quality for finer steps of the
+    // capacity levels against the default step of 2
+    void steps(size_t repetitions) {
+        std::vector<Variant> variants;
+        for(double step : {2., 1.5, 1.2, 1.1, 1.05}) {
+            std::ostringstream name;
+            name << "step " << step;
+            variants.emplace_back(name.str(), liblabel::Config());
+            variants.back().second.stepSize = step;
+        }
+        compareVariants("Steps of the capacity levels", repetitions, variants[0], variants, {
+            {"path search ms", 3, [](const liblabel::LabelStats& s) { return 1000 * s.pathSearchSeconds; }},
+            {"levels", 0, [](const liblabel::LabelStats& s) { return double(s.capacityLevels); }},
+        });
+    }
+
+    // Path search on the full and on the compacted skeleton graph, quality
+    // relative to the full graph
+    void compaction(size_t repetitions) {
+        Variant full = {"full", liblabel::Config()}, compacted = {"compacted", liblabel::Config()};
+        full.second.compactSkeleton = false;
+        compacted.second.compactSkeleton = true;
+        compareVariants("Skeleton graph compaction", repetitions, full, {full, compacted}, {
+            {"path search ms", 3, [](const liblabel::LabelStats& s) { return 1000 * s.pathSearchSeconds; }},
+            {"vertices", 0, [](const liblabel::LabelStats& s) { return double(s.compactVertices); }},
+            {"edges", 0, [](const liblabel::LabelStats& s) { return double(s.compactEdges); }},
+            {"spurs", 0, [](const liblabel::LabelStats& s) { return double(s.prunedSpurs); }},
+        });
+    }
+
+    // Time to get the polygons into memory from the text format of the
+    // command line interface and from a binary corpus, next to the time
+    // to label them
+    void ingest(size_t count) {
+        auto polygons = bench::polygons(count);
+        double secondsPerLabel = 0;
+        {
+            liblabel::LabelingWorkspace workspace;
+            size_t sample = std::min<size_t>(polygons.size(), 32);
+            auto start = Clock::now();
+            for(size_t i = 0; i < sample; ++i) {
+                liblabel::computeLabel(0.2, polygons[i], workspace);
+            }
+            secondsPerLabel = std::chrono::duration<double>(Clock::now() - start).count() / std::max<size_t>(sample, 1);
+        }
+
+        std::ostringstream text;
+        text << std::setprecision(std::numeric_limits<double>::digits10 + 1);
+        auto writeRing = [&text](const liblabel::Polyline& ring) {
+            for(const auto& p : ring.points) {
+                text << p.x << " " << p.y << " ";
+            }
+            text << "\n";
+        };
+        for(size_t i = 0; i < polygons.size(); ++i) {
+            text << i << " 0.2\n";
+            writeRing(polygons[i].outer);
+            for(const auto& hole : polygons[i].holes) {
+                writeRing(hole);
+            }
+            text << "\n";
+        }
+        std::string textData = text.str();
+
+        // The parser of the streaming input of the command line interface
+        auto start = Clock::now();
+        std::istringstream in(textData);
+        size_t parsed = 0;
+        while(auto record = records::readRecord(in)) {
+            if(record->error.empty()) {
+                ++parsed;
+            }
+        }
+        double textSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        cout << "Ingest of " << parsed << " polygons, labeling takes "
+             << std::fixed << std::setprecision(3) << 1e6 * secondsPerLabel << " us per polygon" << endl;
+        cout << std::left << std::setw(18) << "format" << std::right << std::setw(12) << "MB"
+             << std::setw(16) << "us / polygon" << std::setw(16) << "share of label" << endl;
+        auto print = [&](const std::string& name, double bytes, double seconds) {
+            double perPolygon = seconds / std::max<size_t>(polygons.size(), 1);
+            cout << std::left << std::setw(18) << name << std::right << std::fixed
+                 << std::setprecision(2) << std::setw(12) << bytes / 1e6
+                 << std::setprecision(3) << std::setw(16) << 1e6 * perPolygon
+                 << std::setw(15) << 100 * perPolygon / secondsPerLabel << "%" << endl;
+        };
+        print("text", textData.size(), textSeconds);
+
+        liblabel::Polygon poly;
+        for(bool quantize : {false, true}) {
+            std::string path = "labeling_bench_ingest.corpus";
+            {
+                liblabel::CorpusWriter writer(path, quantize);
+                for(size_t i = 0; i < polygons.size(); ++i) {
+                    writer.add(std::to_string(i), 0.2, polygons[i]);
+                }
+            }
+            start = Clock::now();
+            {
+                liblabel::CorpusReader reader(path);
+                for(size_t i = 0; i < reader.size(); ++i) {
+                    reader[i].toPolygon(poly);
+                }
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            print(quantize ? "corpus quantized" : "corpus", file.tellg(), seconds);
+            std::remove(path.c_str());
+        }
+    }
+
+    // Stage benchmarks and end-to-end labeling of the corpus
+    bench::Suite runSuite() {
+        auto corpus = bench::loadCorpus();
+
+        std::vector<bench::Record> fixtures = corpus;
+        std::mt19937 rng(42);
+        for(size_t n : {100, 400}) {
+            fixtures.push_back({"synthetic_" + std::to_string(n), 0.2, bench::syntheticPolygon(n, rng)});
+        }
+
+        bench::Suite suite;
+        bench::stageBenchmarks(fixtures, suite);
+
+        for(size_t n : {50, 200, 800}) {
+            corpus.push_back({"synthetic_" + std::to_string(n), 0.2, bench::syntheticPolygon(n, rng)});
+        }
+        liblabel::LabelingWorkspace workspace;
+        for(const auto& record : corpus) {
+            suite.run("computeLabel/" + record.name, [&]() {
+                liblabel::computeLabel(record.aspect, record.polygon, workspace);
+            });
+        }
+
+        // Evaluation of all candidates without the bound based pruning
+        liblabel::Config unpruned;
+        unpruned.pruneCandidates = false;
+        for(const auto& record : corpus) {
+            suite.run("computeLabel_unpruned/" + record.name, [&]() {
+                liblabel::computeLabel(record.aspect, record.polygon, workspace, false, unpruned);
+            });
+        }
+
+        // Labels of several texts for the same polygon
+        const std::vector<liblabel::Aspect> aspects = {0.1, 0.15, 0.2, 0.3};
+        for(const auto& record : corpus) {
+            suite.run("aspects_separate/" + record.name, [&]() {
+                for(auto aspect : aspects) {
+                    liblabel::computeLabel(aspect, record.polygon, workspace);
+                }
+            });
+            suite.run("aspects_shared/" + record.name, [&]() {
+                liblabel::computeLabelsForAspects(aspects, record.polygon, workspace);
+            });
+        }
+        return suite;
+    }
+}
+
+int main(int argc, char** argv) {
+    // The comparisons of configuration variants, all take the repetitions
+    const std::map<std::string, void (*)(size_t)> comparisons = {
+        {"subsampling", subsampling},
+        {"backends", backends},
+        {"kernels", kernels},
+        {"steps", steps},
+        {"compaction", compaction},
+    };
+
+    std::string mode = argc > 1 ? argv[1] : "";
+    if(mode == "run") {
+        auto suite = runSuite();
+        if(argc > 2) {
+            std::ofstream out(argv[2]);
+            bench::writeJson(suite.results(), out);
+        } else {
+            bench::writeJson(suite.results(), cout);
+        }
+    } else if(mode == "compare" && argc > 2) {
+        std::ifstream in(argv[2]);
+        if(!in) {
+            std::cerr << "Could not open the baseline " << argv[2] << endl;
+            return 2;
+        }
+        auto baseline = bench::readJson(in);
+        double tolerance = argc > 3 ? std::stod(argv[3]) : 0.1;
+
+        auto suite = runSuite();
+        size_t regressions = bench::compare(baseline, suite.results(), tolerance, cout);
+        cout << regressions << " regression(s) above " << tolerance * 100 << "%" << endl;
+        return regressions > 0 ? 1 : 0;
+    } else if(mode == "scaling") {
+        size_t count = argc > 2 ? std::stoul(argv[2]) : 256;
+        size_t maxThreads = argc > 3 ? std::stoul(argv[3])
+                                     : std::max(1u, std::thread::hardware_concurrency());
+        scaling(count, maxThreads);
+    } else if(auto comparison = comparisons.find(mode); comparison != comparisons.end()) {
+        size_t repetitions = argc > 2 ? std::stoul(argv[2]) : 3;
+        comparison->second(repetitions);
+    } else if(mode == "allocs") {
+        size_t count = argc > 2 ? std::stoul(argv[2]) : 64;
+        allocs(count);
+    } else if(mode == "skeleton") {
+        size_t maxVertices = argc > 2 ? std::stoul(argv[2]) : 1000000;
+        bench::skeletonScaling(maxVertices, cout);
+    } else if(mode == "ingest") {
+        size_t count = argc > 2 ? std::stoul(argv[2]) : 10000;
+        ingest(count);
+    } else {
+        cout << "Please use one of the benchmarks:\n"
+             << "  run [output.json]\t\t\tstage and end-to-end benchmarks as JSON\n"
+             << "  compare <baseline.json> [tolerance]\tflag benchmarks slower than the baseline\n"
+             << "  scaling [polygons] [max threads]\tbatch throughput per thread count\n"
+             << "  subsampling [repetitions]\t\ttime and quality of the subsampling variants\n"
+             << "  backends [repetitions]\t\ttime and quality of the skeleton backends\n"
+             << "  kernels [repetitions]\t\t\ttime of the path evaluation per kernel\n"
+             << "  steps [repetitions]\t\t\ttime and quality of finer capacity steps\n"
+             << "  compaction [repetitions]\t\tpath search on the compacted skeleton graph\n"
+             << "  allocs [polygons]\t\t\theap allocations per label\n"
+             << "  ingest [polygons]\t\t\treading text input vs. a binary corpus\n"
+             << "  skeleton [max vertices]\t\tskeleton construction for growing polygons" << endl;
+    }
+    return 0;
+}
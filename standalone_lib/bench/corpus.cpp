@@ -0,0 +1,103 @@
+#include "corpus.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+    // Parses a line of coordinates, a repeated first point closing the ring is dropped
+    liblabel::Polyline parseRing(const std::string& line) {
+        std::istringstream stream(line);
+        std::vector<double> coords{std::istream_iterator<double>(stream),
+                                   std::istream_iterator<double>()};
+        if(coords.size() >= 4 && coords[0] == coords[coords.size()-2]
+                              && coords[1] == coords[coords.size()-1]) {
+            coords.resize(coords.size() - 2);
+        }
+
+        liblabel::Polyline pl;
+        for(size_t i = 0; i + 1 < coords.size(); i += 2) {
+            pl.points.push_back({coords[i], coords[i+1]});
+        }
+        return pl;
+    }
+
+    bench::Record readRecord(const std::filesystem::path& file) {
+        std::ifstream in(file);
+        if(!in) {
+            throw std::runtime_error("Could not open " + file.string());
+        }
+
+        bench::Record record{file.stem().string(), 0, {}};
+        std::string line;
+        std::getline(in, line);
+        record.aspect = std::stod(line);
+        std::getline(in, line);
+        record.polygon.outer = parseRing(line);
+        while(std::getline(in, line)) {
+            auto hole = parseRing(line);
+            if(hole.points.empty()) {
+                break;
+            }
+            record.polygon.holes.push_back(hole);
+        }
+        return record;
+    }
+}
+
+std::vector<bench::Record> bench::loadCorpus(const std::string& directory) {
+    std::vector<std::filesystem::path> files;
+    for(const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if(entry.path().extension() == ".txt") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    std::vector<Record> records;
+    for(const auto& file : files) {
+        records.push_back(readRecord(file));
+    }
+    return records;
+}
+
+liblabel::Polygon bench::syntheticPolygon(size_t n, std::mt19937& rng) {
+    std::uniform_real_distribution<double> noise(-0.1, 0.1);
+    std::uniform_int_distribution<int> waves(2, 7);
+    int k = waves(rng);
+
+    liblabel::Polygon poly;
+    for(size_t i = 0; i < n; ++i) {
+        double angle = 2 * M_PI * i / n;
+        double r = 10. * (1 + 0.3 * std::sin(k * angle) + noise(rng));
+        poly.outer.points.push_back({r * std::cos(angle), r * std::sin(angle)});
+    }
+
+    liblabel::Polyline hole;
+    for(size_t i = 0; i < 12; ++i) {
+        double angle = -2 * M_PI * i / 12;
+        hole.points.push_back({2 + 1.5 * std::cos(angle), 1.5 * std::sin(angle)});
+    }
+    poly.holes.push_back(hole);
+    return poly;
+}
+
+std::vector<liblabel::Polygon> bench::polygons(size_t count) {
+    std::vector<liblabel::Polygon> res;
+    for(auto& record : loadCorpus()) {
+        if(res.size() < count) {
+            res.push_back(std::move(record.polygon));
+        }
+    }
+
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<size_t> sizes(20, 400);
+    while(res.size() < count) {
+        res.push_back(syntheticPolygon(sizes(rng), rng));
+    }
+    return res;
+}
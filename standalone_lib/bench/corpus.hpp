@@ -0,0 +1,38 @@
+#ifndef BENCH_CORPUS_HPP
+#define BENCH_CORPUS_HPP
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "liblabeling.h"
+
+#ifndef LABELING_BENCH_CORPUS
+#define LABELING_BENCH_CORPUS "corpus"
+#endif
+
+namespace bench {
+    /**
+     * A polygon of the benchmark corpus together with the aspect of its label.
+     */
+    struct Record {
+        std::string name;
+        liblabel::Aspect aspect;
+        liblabel::Polygon polygon;
+    };
+
+    /**
+     * Reads all records of the checked-in corpus, ordered by file name.
+     * Every file uses the streaming input format of the labeling binary:
+     * the aspect, the outer boundary and one line per hole.
+     */
+    std::vector<Record> loadCorpus(const std::string& directory = LABELING_BENCH_CORPUS);
+
+    // A wavy star shaped polygon with n vertices and a circular hole
+    liblabel::Polygon syntheticPolygon(size_t n, std::mt19937& rng);
+
+    // The corpus polygons followed by synthetic ones up to count polygons
+    std::vector<liblabel::Polygon> polygons(size_t count);
+}
+
+#endif /* BENCH_CORPUS_HPP */
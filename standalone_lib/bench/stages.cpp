@@ -0,0 +1,141 @@
+#include "stages.hpp"
+
+#include <chrono>
+#include <iomanip>
+
+#include "circle_apx.hpp"
+#include "compact_graph.hpp"
+#include "csr_graph.hpp"
+#include "label_fit.hpp"
+#include "longest_paths.hpp"
+#include "segments_to_graph.hpp"
+
+namespace {
+    std::vector<Segment> boundarySegments(const liblabel::Polygon& poly) {
+        std::vector<Segment> segs;
+        auto addRing = [&segs](const liblabel::Polyline& ring) {
+            const auto& pts = ring.points;
+            for(size_t i = 0; i < pts.size(); ++i) {
+                const auto& s = pts[i];
+                const auto& t = pts[(i + 1) % pts.size()];
+                segs.emplace_back(Point(s.x, s.y), Point(t.x, t.y));
+            }
+        };
+
+        addRing(poly.outer);
+        for(const auto& hole : poly.holes) {
+            addRing(hole);
+        }
+        return segs;
+    }
+}
+
+void bench::stageBenchmarks(const std::vector<Record>& fixtures, Suite& suite) {
+    const liblabel::Config config;
+
+    for(const auto& fixture : fixtures) {
+        const std::string& name = fixture.name;
+        auto segs = boundarySegments(fixture.polygon);
+
+        // The CDT is rebuilt in every call as the skeleton construction
+        // inserts Steiner points into it
+        std::vector<SkeletonEdge> skeletonEdges;
+        suite.run("compute_skeleton_edges/" + name, [&]() {
+            CDT cdt(segs.begin(), segs.end());
+            compute_skeleton_edges(cdt, skeletonEdges);
+        });
+
+        std::vector<longest_paths::Segment> edges;
+        for(const auto& e : skeletonEdges) {
+            edges.push_back({{e.p.x(), e.p.y()}, {e.q.x(), e.q.y()}, CGAL::squared_distance(e.p, e.q), e.d, e.p_id, e.q_id});
+        }
+        // The adjacency_list of longest_paths.hpp and the compressed graph
+        // the library searches, both find the same paths
+        Graph graph;
+        GraphBuilder builder;
+        PathSearchBuffers buffers;
+        std::vector<std::vector<Vertex>> paths;
+        suite.run("find_distinct_paths/" + name, [&]() {
+            from_edges(edges, graph, builder);
+            find_distinct_paths(graph, fixture.aspect, config.stepSize, config.numberOfPaths, buffers, paths);
+        });
+        csr::CsrGraph csrGraph;
+        csr::Builder csrBuilder;
+        csr::SearchBuffers csrBuffers;
+        suite.run("csr_find_distinct_paths/" + name, [&]() {
+            csr::from_edges(edges, csrGraph, csrBuilder);
+            csr::find_distinct_paths(csrGraph, fixture.aspect, config.stepSize, config.numberOfPaths, csrBuffers, paths);
+        });
+        csr::CsrGraph compactGraph;
+        csr::Compaction compaction;
+        csr::CompactionBuffers compactionBuffers;
+        std::vector<std::vector<Vertex>> compactPaths;
+        suite.run("compact+csr_find_distinct_paths/" + name, [&]() {
+            csr::compact(csrGraph, compactGraph, compaction, compactionBuffers);
+            csr::find_distinct_paths(compactGraph, fixture.aspect, config.stepSize, config.numberOfPaths, csrBuffers, compactPaths);
+        });
+        if(paths.empty()) {
+            continue;
+        }
+
+        std::vector<std::vector<circle_apx_nsp::Point>> pathPoints;
+        for(const auto& path : paths) {
+            pathPoints.emplace_back();
+            for(Vertex v : path) {
+                pathPoints.back().push_back({csrGraph.nodes[v].x, csrGraph.nodes[v].y});
+            }
+        }
+        std::vector<circle_apx_nsp::Circle> circles(pathPoints.size());
+        suite.run("apx_circle/" + name, [&]() {
+            for(size_t i = 0; i < pathPoints.size(); ++i) {
+                circles[i] = apx_circle(pathPoints[i]);
+            }
+        });
+
+        std::vector<Cup> cups;
+        std::vector<Point_2> highPoints;
+        HighPointBuffers highPointBuffers;
+        suite.run("compute_all_cups+high_points/" + name, [&]() {
+            for(const auto& c : circles) {
+                Circle_2 circle({c.x, c.y}, c.r*c.r);
+                compute_all_cups(segs, circle, fixture.aspect, cups);
+                high_points(cups, highPoints, highPointBuffers);
+            }
+        });
+    }
+}
+
+void bench::skeletonScaling(size_t maxVertices, std::ostream& out) {
+    using Clock = std::chrono::steady_clock;
+    auto seconds = [](Clock::time_point start) {
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    };
+
+    out << std::setw(10) << "vertices" << std::setw(12) << "steiner" << std::setw(12) << "edges"
+        << std::setw(10) << "cdt s" << std::setw(12) << "skeleton s" << std::setw(12) << "extract s"
+        << std::setw(14) << "extract us/v" << std::endl;
+    std::mt19937 rng(11);
+    for(size_t n = 1000; n <= maxVertices; n *= 10) {
+        auto segs = boundarySegments(syntheticPolygon(n, rng));
+        std::vector<SkeletonEdge> skeletonEdges;
+
+        auto start = Clock::now();
+        CDT cdt(segs.begin(), segs.end());
+        double cdtSeconds = seconds(start);
+
+        start = Clock::now();
+        size_t steinerPoints = compute_skeleton_edges(cdt, skeletonEdges);
+        double skeletonSeconds = seconds(start);
+
+        // The CDT is conforming now, so a second call only extracts
+        start = Clock::now();
+        compute_skeleton_edges(cdt, skeletonEdges);
+        double extractSeconds = seconds(start);
+
+        out << std::fixed << std::setw(10) << n << std::setw(12) << steinerPoints
+            << std::setw(12) << skeletonEdges.size() << std::setprecision(3)
+            << std::setw(10) << cdtSeconds << std::setw(12) << skeletonSeconds
+            << std::setw(12) << extractSeconds
+            << std::setw(14) << 1e6 * extractSeconds / cdt.number_of_vertices() << std::endl;
+    }
+}
@@ -0,0 +1,28 @@
+#ifndef BENCH_STAGES_HPP
+#define BENCH_STAGES_HPP
+
+#include <ostream>
+#include <vector>
+
+#include "corpus.hpp"
+#include "suite.hpp"
+
+namespace bench {
+    /**
+     * Benchmarks the single stages of the pipeline on the given polygons:
+     * skeleton construction, path search, circle approximation and the
+     * label fitting (cups and high points). The stages are fed with the
+     * output of the previous stage, the polygons are not subsampled.
+     */
+    void stageBenchmarks(const std::vector<Record>& fixtures, Suite& suite);
+
+    /**
+     * Prints the time of the skeleton construction for synthetic polygons
+     * of 10^3 up to maxVertices vertices: building the CDT, making it
+     * conforming together with the extraction of the skeleton edges, and
+     * the extraction alone on the conforming CDT.
+     */
+    void skeletonScaling(size_t maxVertices, std::ostream& out);
+}
+
+#endif /* BENCH_STAGES_HPP */
@@ -0,0 +1,88 @@
+#include "suite.hpp"
+
+#include <iomanip>
+#include <limits>
+#include <map>
+#include <stdexcept>
+
+namespace {
+    // Value of "key": in a line written by writeJson
+    std::string field(const std::string& line, const std::string& key) {
+        std::string pattern = "\"" + key + "\": ";
+        size_t start = line.find(pattern);
+        if(start == std::string::npos) {
+            throw std::runtime_error("Missing field " + key + " in: " + line);
+        }
+        start += pattern.size();
+        if(line[start] == '"') {
+            return line.substr(start + 1, line.find('"', start + 1) - start - 1);
+        }
+        return line.substr(start, line.find_first_of(",}", start) - start);
+    }
+}
+
+void bench::writeJson(const std::vector<Measurement>& measurements, std::ostream& out) {
+    out << std::setprecision(std::numeric_limits<double>::digits10 + 1);
+    out << "{\n  \"benchmarks\": [\n";
+    for(size_t i = 0; i < measurements.size(); ++i) {
+        const auto& m = measurements[i];
+        out << "    {\"name\": \"" << m.name << "\""
+            << ", \"iterations\": " << m.iterations
+            << ", \"median_seconds\": " << m.medianSeconds
+            << ", \"min_seconds\": " << m.minSeconds << "}"
+            << (i + 1 < measurements.size() ? ",\n" : "\n");
+    }
+    out << "  ]\n}" << std::endl;
+}
+
+std::vector<bench::Measurement> bench::readJson(std::istream& in) {
+    std::vector<Measurement> measurements;
+    for(std::string line; std::getline(in, line);) {
+        if(line.find("\"name\"") == std::string::npos) {
+            continue;
+        }
+        measurements.push_back({
+            field(line, "name"),
+            std::stoul(field(line, "iterations")),
+            std::stod(field(line, "median_seconds")),
+            std::stod(field(line, "min_seconds"))
+        });
+    }
+    return measurements;
+}
+
+size_t bench::compare(const std::vector<Measurement>& baseline,
+                      const std::vector<Measurement>& current,
+                      double tolerance,
+                      std::ostream& out) {
+    std::map<std::string, double> before;
+    for(const auto& m : baseline) {
+        before[m.name] = m.medianSeconds;
+    }
+
+    size_t regressions = 0;
+    out << std::left << std::setw(48) << "benchmark" << std::right
+        << std::setw(14) << "baseline [s]" << std::setw(14) << "current [s]"
+        << std::setw(10) << "ratio" << std::endl;
+    for(const auto& m : current) {
+        out << std::left << std::setw(48) << m.name << std::right;
+        auto it = before.find(m.name);
+        if(it == before.end()) {
+            out << std::setw(14) << "-" << std::setw(14) << std::scientific
+                << std::setprecision(3) << m.medianSeconds << std::defaultfloat
+                << std::setw(10) << "new" << std::endl;
+            continue;
+        }
+
+        double ratio = m.medianSeconds / it->second;
+        out << std::scientific << std::setprecision(3)
+            << std::setw(14) << it->second << std::setw(14) << m.medianSeconds
+            << std::fixed << std::setw(10) << ratio << std::defaultfloat;
+        if(ratio > 1 + tolerance) {
+            out << "  REGRESSION";
+            ++regressions;
+        }
+        out << std::endl;
+    }
+    return regressions;
+}
@@ -0,0 +1,87 @@
+#ifndef BENCH_SUITE_HPP
+#define BENCH_SUITE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace bench {
+    struct Measurement {
+        std::string name;
+        // Number of timed calls
+        size_t iterations;
+        // Median and minimum wall time of a single call over all samples
+        double medianSeconds, minSeconds;
+    };
+
+    /**
+     * Collects the timings of named benchmarks. Every benchmark is called
+     * once to warm up, then the number of calls per sample is doubled until a
+     * sample takes long enough to be measured reliably.
+     */
+    class Suite {
+    public:
+        template <class F>
+        void run(const std::string& name, F&& fn) {
+            using Clock = std::chrono::steady_clock;
+            auto time = [&fn](size_t calls) {
+                auto start = Clock::now();
+                for(size_t i = 0; i < calls; ++i) {
+                    fn();
+                }
+                return std::chrono::duration<double>(Clock::now() - start).count();
+            };
+
+            try {
+                fn();
+                size_t calls = 1;
+                while(time(calls) < MIN_SAMPLE_SECONDS && calls < MAX_CALLS) {
+                    calls *= 2;
+                }
+
+                std::vector<double> samples;
+                for(size_t s = 0; s < SAMPLES; ++s) {
+                    samples.push_back(time(calls) / calls);
+                }
+                std::sort(samples.begin(), samples.end());
+                measurements.push_back({name, calls * SAMPLES, samples[SAMPLES / 2], samples[0]});
+            } catch(const std::exception& e) {
+                std::cerr << "Benchmark " << name << " failed: " << e.what() << std::endl;
+            }
+        }
+
+        const std::vector<Measurement>& results() const { return measurements; }
+
+    private:
+        static constexpr double MIN_SAMPLE_SECONDS = 0.01;
+        static constexpr size_t MAX_CALLS = 1 << 20;
+        static constexpr size_t SAMPLES = 7;
+
+        std::vector<Measurement> measurements;
+    };
+
+    /**
+     * Writes the measurements as a JSON document, one benchmark per line.
+     */
+    void writeJson(const std::vector<Measurement>&, std::ostream&);
+
+    /**
+     * Reads measurements written by writeJson.
+     */
+    std::vector<Measurement> readJson(std::istream&);
+
+    /**
+     * Prints the current measurements next to the baseline. A benchmark whose
+     * median got slower by more than the tolerance (relative, e.g. 0.1 for
+     * 10%) is flagged as a regression. Returns the number of regressions.
+     */
+    size_t compare(const std::vector<Measurement>& baseline,
+                   const std::vector<Measurement>& current,
+                   double tolerance,
+                   std::ostream&);
+}
+
+#endif /* BENCH_SUITE_HPP */
@@ -1,11 +1,17 @@
 #include <algorithm>
 #include <cassert>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <sstream>
 
+#include "daemon.hpp"
+#include "labelcorpus.h"
+#include "labelskeleton.h"
 #include "liblabeling.h"
+#include "record_stream.hpp"
 
 using std::cin;
 using std::cout;
@@ -107,10 +113,100 @@ Input interactiveInput() {
     return {aspect, {outer, holes}};
 }
 
+const char* USAGE =
+    "Please use -i for interactive or -s for streamed input.\n"
+    "Use -m [-j threads] [-w window] [-f ndjson|tsv] [-t seconds] to label\n"
+    "a stream of records separated by empty lines, each given as\n"
+    "'<id> <aspect>', the outer boundary and the holes on one line each.\n"
+    "Add -r <corpus> to label a binary corpus instead of the standard input,\n"
+    "-K <skeleton store> to label precomputed skeletons and -a <aspect> to\n"
+    "replace the aspects of the records.\n"
+    "Use -c <records> <corpus> [-q] to convert records to a binary corpus,\n"
+    "-q quantizes the coordinates to 32 bit integers.\n"
+    "Use -P <corpus> <skeleton store> [-j threads] to precompute the skeletons\n"
+    "of a corpus for -m -K.\n"
+    "Use -g [-j threads] [-w window] [-t seconds] to label the features of\n"
+    "a GeoJSON document.\n"
+    "Use -d <socket> [-j threads] [-q queue] [-n in-flight] [-f ndjson|tsv]\n"
+    "[-t seconds] [-C cached labels] [-D cache folder] to run a daemon\n"
+    "answering records on a Unix domain socket until SIGINT or SIGTERM.\n"
+    "Use -k <socket> [-w window] to label the records of the standard input\n"
+    "with a running daemon, -k <socket> -S prints its statistics.";
+
+// Parses the options of the -m mode from argv[first] on, returns false on
+// invalid options
+bool parseStreamOptions(int argc, char** argv, int first, records::StreamConfig& config, std::string& corpus, std::string& store) {
+    for(int i = first; i < argc; ++i) {
+        std::string option = argv[i];
+        if(i + 1 == argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if(option == "-j") {
+                config.threads = std::stoul(value);
+            } else if(option == "-w") {
+                config.window = std::stoul(value);
+            } else if(option == "-r") {
+                corpus = value;
+            } else if(option == "-K") {
+                store = value;
+            } else if(option == "-a") {
+                config.aspect = std::stod(value);
+            } else if(option == "-t") {
+                config.config.timeBudget = std::stod(value);
+            } else if(option == "-f" && (value == "ndjson" || value == "tsv")) {
+                config.format = value == "tsv" ? records::Format::TSV : records::Format::NDJSON;
+            } else {
+                return false;
+            }
+        } catch(const std::exception&) {
+            return false;
+        }
+    }
+    return corpus.empty() || store.empty();
+}
+
+// Parses the options of the -d mode, returns false on invalid options
+bool parseDaemonOptions(int argc, char** argv, labeld::DaemonConfig& config) {
+    if(argc < 3) {
+        return false;
+    }
+    config.socket = argv[2];
+    for(int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        if(i + 1 == argc) {
+            return false;
+        }
+        std::string value = argv[++i];
+        try {
+            if(option == "-j") {
+                config.threads = std::stoul(value);
+            } else if(option == "-q") {
+                config.queue = std::stoul(value);
+            } else if(option == "-n") {
+                config.inFlight = std::stoul(value);
+            } else if(option == "-t") {
+                config.config.timeBudget = std::stod(value);
+            } else if(option == "-C") {
+                config.cache.capacity = std::stoul(value);
+            } else if(option == "-D") {
+                config.cache.directory = value;
+            } else if(option == "-f" && (value == "ndjson" || value == "tsv")) {
+                config.format = value == "tsv" ? records::Format::TSV : records::Format::NDJSON;
+            } else {
+                return false;
+            }
+        } catch(const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char** argv) {
     if(argc < 2) {
-        cout << "Please use -i for interactive or -s for streamed input."
-             << endl;
+        cout << USAGE << endl;
     } else if ("-i" == std::string(argv[1])) {
         cout << "Get labeling parameters interactively!" << endl;
         Input input = interactiveInput();
@@ -152,9 +248,130 @@ int main(int argc, char** argv) {
         } else {
             cerr << "Label for the given input could not be constructed!" << endl;
         }
+    } else if ("-m" == std::string(argv[1])) {
+        records::StreamConfig config;
+        std::string corpus, store;
+        if(!parseStreamOptions(argc, argv, 2, config, corpus, store)) {
+            cerr << USAGE << endl;
+            return 2;
+        }
+        std::ios::sync_with_stdio(false);
+        size_t failures;
+        if(corpus.empty() && store.empty()) {
+            failures = records::labelRecords(cin, cout, config);
+        } else {
+            try {
+                if(!corpus.empty()) {
+                    liblabel::CorpusReader reader(corpus);
+                    failures = records::labelCorpus(reader, cout, config);
+                } else {
+                    liblabel::SkeletonStoreReader reader(store);
+                    config.config.vertexBudget = reader.config().vertexBudget;
+                    config.config.sampling = reader.config().sampling;
+                    config.config.skeleton = reader.config().skeleton;
+                    config.config.simplifyTolerance = reader.config().simplifyTolerance;
+                    failures = records::labelSkeletonStore(reader, cout, config);
+                }
+            } catch(const std::exception& e) {
+                cerr << e.what() << endl;
+                return 2;
+            }
+        }
+        return failures > 0 ? 1 : 0;
+    } else if ("-g" == std::string(argv[1])) {
+        records::StreamConfig config;
+        std::string corpus, store;
+        if(!parseStreamOptions(argc, argv, 2, config, corpus, store) || !corpus.empty() || !store.empty()) {
+            cerr << USAGE << endl;
+            return 2;
+        }
+        std::ios::sync_with_stdio(false);
+        try {
+            size_t failures = records::labelGeoJson(cin, cout, config);
+            return failures > 0 ? 1 : 0;
+        } catch(const std::exception& e) {
+            cerr << e.what() << endl;
+            return 2;
+        }
+    } else if ("-c" == std::string(argv[1]) && (argc == 4 || (argc == 5 && "-q" == std::string(argv[4])))) {
+        std::ifstream in(argv[2]);
+        if(!in) {
+            cerr << "Could not open " << argv[2] << endl;
+            return 2;
+        }
+        size_t converted = 0, skipped = 0;
+        try {
+            liblabel::CorpusWriter writer(argv[3], argc == 5);
+            while(auto record = records::readRecord(in)) {
+                if(!record->error.empty()) {
+                    cerr << "Skipping record " << record->id << ": " << record->error << endl;
+                    ++skipped;
+                    continue;
+                }
+                writer.add(record->id, record->aspect, record->poly);
+                ++converted;
+            }
+            writer.finish();
+        } catch(const std::exception& e) {
+            cerr << e.what() << endl;
+            return 2;
+        }
+        cerr << "Converted " << converted << " records, skipped " << skipped << endl;
+        return skipped > 0 ? 1 : 0;
+    } else if ("-P" == std::string(argv[1]) && argc >= 4) {
+        records::StreamConfig config;
+        std::string corpus, store;
+        if(!parseStreamOptions(argc, argv, 4, config, corpus, store) || !corpus.empty() || !store.empty() || config.aspect > 0) {
+            cerr << USAGE << endl;
+            return 2;
+        }
+        size_t missing;
+        try {
+            liblabel::CorpusReader reader(argv[2]);
+            liblabel::SkeletonStoreWriter writer(argv[3], config.config);
+            missing = records::precomputeSkeletons(reader, writer, config);
+            writer.finish();
+            cerr << "Stored " << reader.size() - missing << " skeletons, " << missing << " missing" << endl;
+        } catch(const std::exception& e) {
+            cerr << e.what() << endl;
+            return 2;
+        }
+        return missing > 0 ? 1 : 0;
+    } else if ("-d" == std::string(argv[1])) {
+        labeld::DaemonConfig config;
+        if(!parseDaemonOptions(argc, argv, config)) {
+            cerr << USAGE << endl;
+            return 2;
+        }
+        try {
+            labeld::serve(config);
+        } catch(const std::exception& e) {
+            cerr << e.what() << endl;
+            return 2;
+        }
+    } else if ("-k" == std::string(argv[1]) && argc >= 3) {
+        std::string socket = argv[2];
+        try {
+            if(argc == 4 && "-S" == std::string(argv[3])) {
+                cout << labeld::remoteStats(socket) << endl;
+                return 0;
+            }
+            size_t window = 64;
+            if(argc == 5 && "-w" == std::string(argv[3])) {
+                window = std::stoul(argv[4]);
+            } else if(argc != 3) {
+                cerr << USAGE << endl;
+                return 2;
+            }
+            std::ios::sync_with_stdio(false);
+            size_t failures = labeld::labelRemote(socket, cin, cout, window);
+            return failures > 0 ? 1 : 0;
+        } catch(const std::exception& e) {
+            cerr << e.what() << endl;
+            return 2;
+        }
     } else {
-        cout << "Please use -i for interactive or -s for streamed input."
-             << endl;
+        cout << USAGE << endl;
     }
     return 0;
 }
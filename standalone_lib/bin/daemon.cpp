@@ -0,0 +1,763 @@
+#include "daemon.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    const size_t HEADER_SIZE = 3 * sizeof(uint32_t);
+    // Larger frames are treated as garbage and end the connection
+    const uint32_t MAX_PAYLOAD = 64u << 20;
+
+    struct Header {
+        uint32_t length, tag, kind;
+    };
+
+    std::runtime_error systemError(const std::string& what) {
+        return std::runtime_error(what + ": " + std::strerror(errno));
+    }
+
+    // Reads exactly size bytes, returns false if the peer closed the
+    // connection before the first one
+    bool readFully(int fd, char* data, size_t size) {
+        size_t done = 0;
+        while(done < size) {
+            ssize_t n = ::read(fd, data + done, size - done);
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n < 0) {
+                throw systemError("Could not read from the socket");
+            }
+            if(n == 0) {
+                if(done == 0) {
+                    return false;
+                }
+                throw std::runtime_error("Connection closed within a frame");
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    bool writeFully(int fd, const char* data, size_t size) {
+        size_t done = 0;
+        while(done < size) {
+            ssize_t n = ::write(fd, data + done, size - done);
+            if(n < 0 && errno == EINTR) {
+                continue;
+            }
+            if(n <= 0) {
+                return false;
+            }
+            done += n;
+        }
+        return true;
+    }
+
+    // Returns false at the end of the stream
+    bool readFrame(int fd, Header& header, std::string& payload) {
+        uint32_t raw[3];
+        if(!readFully(fd, reinterpret_cast<char*>(raw), HEADER_SIZE)) {
+            return false;
+        }
+        header = {ntohl(raw[0]), ntohl(raw[1]), ntohl(raw[2])};
+        if(header.length > MAX_PAYLOAD) {
+            throw std::runtime_error("Frame of " + std::to_string(header.length) + " bytes exceeds the limit");
+        }
+        payload.resize(header.length);
+        if(header.length > 0 && !readFully(fd, payload.data(), header.length)) {
+            throw std::runtime_error("Connection closed within a frame");
+        }
+        return true;
+    }
+
+    // The header and the payload in one buffer, so a frame is sent by one
+    // write instead of a tiny packet for the header
+    std::string encodeFrame(uint32_t tag, uint32_t kind, const std::string& payload) {
+        std::string frame(HEADER_SIZE, '\0');
+        uint32_t raw[3] = {htonl(uint32_t(payload.size())), htonl(tag), htonl(kind)};
+        std::memcpy(frame.data(), raw, HEADER_SIZE);
+        frame += payload;
+        return frame;
+    }
+
+    bool writeFrame(int fd, uint32_t tag, uint32_t kind, const std::string& payload) {
+        std::string frame = encodeFrame(tag, kind, payload);
+        return writeFully(fd, frame.data(), frame.size());
+    }
+
+    sockaddr_un socketAddress(const std::string& path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if(path.empty() || path.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error("Invalid socket path '" + path + "'");
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+
+    // Returns the connected socket or -1
+    int connectTo(const std::string& path) {
+        sockaddr_un address = socketAddress(path);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0) {
+            return -1;
+        }
+        if(::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+            int error = errno;
+            ::close(fd);
+            errno = error;
+            return -1;
+        }
+        return fd;
+    }
+
+    int listenOn(const std::string& path) {
+        sockaddr_un address = socketAddress(path);
+        int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0) {
+            throw systemError("Could not create a socket");
+        }
+        bool bound = ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        if(!bound && errno == EADDRINUSE) {
+            // The file of a daemon that did not shut down cleanly is
+            // replaced, a running daemon is left alone
+            int other = connectTo(path);
+            if(other >= 0) {
+                ::close(other);
+                ::close(fd);
+                throw std::runtime_error("Another daemon listens on " + path);
+            }
+            ::unlink(path.c_str());
+            bound = ::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        }
+        if(!bound) {
+            auto error = systemError("Could not bind " + path);
+            ::close(fd);
+            throw error;
+        }
+        if(::listen(fd, SOMAXCONN) != 0) {
+            ::close(fd);
+            throw systemError("Could not listen on " + path);
+        }
+        return fd;
+    }
+
+    // Written by the signal handler to wake up the accepting thread
+    int stopPipe[2] = {-1, -1};
+
+    extern "C" void requestStop(int) {
+        int error = errno;
+        char c = 0;
+        (void) !::write(stopPipe[1], &c, 1);
+        errno = error;
+    }
+
+    class Connection {
+    public:
+        explicit Connection(int fd) : fd(fd) {}
+        ~Connection() { ::close(fd); }
+
+        Connection(const Connection&) = delete;
+        Connection& operator=(const Connection&) = delete;
+
+        // Admits a request once fewer than limit requests of the connection
+        // are queued, being labeled or waiting to be sent. Returns false if
+        // the connection was closed or broke meanwhile.
+        bool admit(size_t limit) {
+            std::unique_lock<std::mutex> lock(mutex);
+            drained.wait(lock, [&]() { return inFlight < limit || closed || broken; });
+            if(closed || broken) {
+                return false;
+            }
+            ++inFlight;
+            return true;
+        }
+
+        // Admits a last response without waiting, e.g. for a broken frame
+        void admitFinal() {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++inFlight;
+        }
+
+        // Stops admitting requests
+        void close() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                closed = true;
+            }
+            drained.notify_all();
+        }
+
+        // Queues the response to an admitted request, returns true if it is
+        // the only queued one, so the writer has to pick the connection up.
+        // A client that went away is ignored.
+        bool queue(std::string frame) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(broken) {
+                --inFlight;
+                return false;
+            }
+            outbox.push_back(std::move(frame));
+            return outbox.size() == 1;
+        }
+
+        // Sends queued frames as far as the socket takes them without
+        // blocking. Returns true while frames are left.
+        bool flush() {
+            size_t sent = 0;
+            bool left;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                while(!outbox.empty()) {
+                    const std::string& frame = outbox.front();
+                    ssize_t n = ::send(fd, frame.data() + offset, frame.size() - offset, MSG_DONTWAIT);
+                    if(n < 0 && errno == EINTR) {
+                        continue;
+                    }
+                    if(n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    }
+                    if(n <= 0) {
+                        // The responses of a client that went away are dropped
+                        broken = true;
+                        sent += outbox.size();
+                        outbox.clear();
+                        break;
+                    }
+                    offset += n;
+                    if(offset == frame.size()) {
+                        outbox.pop_front();
+                        offset = 0;
+                        ++sent;
+                    }
+                }
+                inFlight -= sent;
+                left = !outbox.empty();
+            }
+            if(sent > 0) {
+                drained.notify_all();
+            }
+            return left;
+        }
+
+        // Drops the queued frames of a client that does not read them
+        void abandon() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                broken = true;
+                inFlight -= outbox.size();
+                outbox.clear();
+            }
+            drained.notify_all();
+        }
+
+        const int fd;
+
+    private:
+        std::mutex mutex;
+        std::condition_variable drained;
+        // Admitted requests whose response is not sent yet
+        size_t inFlight = 0;
+        std::deque<std::string> outbox;
+        size_t offset = 0;          // bytes of outbox.front() already sent
+        bool closed = false;
+        bool broken = false;
+    };
+
+    struct Job {
+        std::shared_ptr<Connection> connection;
+        uint32_t tag;
+        std::string payload;
+    };
+
+    class Server {
+    public:
+        explicit Server(const labeld::DaemonConfig& config) : config(config), cache(config.cache) {
+            if(::pipe(wakePipe) != 0) {
+                throw systemError("Could not create a pipe");
+            }
+            // Waking the writer must never block a worker
+            ::fcntl(wakePipe[0], F_SETFL, O_NONBLOCK);
+            ::fcntl(wakePipe[1], F_SETFL, O_NONBLOCK);
+        }
+
+        ~Server() {
+            ::close(wakePipe[0]);
+            ::close(wakePipe[1]);
+        }
+
+        // Serves listenFd until stopFd becomes readable
+        void run(int listenFd, int stopFd) {
+            std::vector<std::thread> workers;
+            size_t threads = config.threads > 0 ? config.threads
+                                                : std::max<size_t>(1, std::thread::hardware_concurrency());
+            for(size_t i = 0; i < threads; ++i) {
+                workers.emplace_back([this]() { work(); });
+            }
+            std::thread writer([this]() { writeResponses(); });
+
+            std::list<Session> sessions;
+            for(;;) {
+                reap(sessions);
+                bool full = sessions.size() >= std::max<size_t>(1, config.connections);
+                pollfd fds[2] = {{stopFd, POLLIN, 0}, {listenFd, POLLIN, 0}};
+                // At the connection limit new clients wait in the backlog,
+                // the poll times out to notice closed sessions
+                int ready = ::poll(fds, full ? 1 : 2, full ? 100 : -1);
+                if(ready < 0 && errno != EINTR) {
+                    // Shut down orderly as if asked to, the workers must
+                    // be joined anyway
+                    std::cerr << systemError("Could not wait for connections").what() << std::endl;
+                    break;
+                }
+                if(fds[0].revents != 0) {
+                    break;
+                }
+                if(full || !(fds[1].revents & POLLIN)) {
+                    continue;
+                }
+                int fd = ::accept(listenFd, nullptr, nullptr);
+                if(fd < 0) {
+                    continue;
+                }
+                ++connectionsAccepted;
+                auto connection = std::make_shared<Connection>(fd);
+                auto& session = sessions.emplace_back();
+                session.connection = connection;
+                session.done = std::make_shared<std::atomic<bool>>(false);
+                session.thread = std::thread([this, connection = std::move(connection), done = session.done]() mutable {
+                    read(connection);
+                    connection.reset();
+                    *done = true;
+                });
+            }
+
+            // No new requests are read, the queued ones are still answered
+            for(auto& session : sessions) {
+                if(auto connection = session.connection.lock()) {
+                    connection->close();
+                    ::shutdown(connection->fd, SHUT_RD);
+                }
+            }
+            for(auto& session : sessions) {
+                session.thread.join();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            notEmpty.notify_all();
+            for(auto& t : workers) {
+                t.join();
+            }
+            {
+                std::lock_guard<std::mutex> lock(outMutex);
+                writerStopping = true;
+            }
+            wake();
+            writer.join();
+        }
+
+    private:
+        struct Session {
+            std::thread thread;
+            // The connection is owned by its reader and the queued requests,
+            // it closes as soon as they are done
+            std::weak_ptr<Connection> connection;
+            std::shared_ptr<std::atomic<bool>> done;
+        };
+
+        // Queues the response to an admitted request of the connection
+        void respond(const std::shared_ptr<Connection>& connection, uint32_t tag,
+                     labeld::ResponseKind kind, const std::string& payload) {
+            if(connection->queue(encodeFrame(tag, uint32_t(kind), payload))) {
+                {
+                    std::lock_guard<std::mutex> lock(outMutex);
+                    ready.push_back(connection);
+                }
+                wake();
+            }
+        }
+
+        void wake() {
+            char c = 0;
+            (void) !::write(wakePipe[1], &c, 1);
+        }
+
+        /*
+         * The writer sends the responses of all connections without
+         * blocking on any of them, waiting in poll for the sockets that
+         * are full. It holds the connections with queued responses, so
+         * they stay open until everything is sent. When the server stops,
+         * clients that do not read for a second lose their responses.
+         */
+        void writeResponses() {
+            std::vector<std::shared_ptr<Connection>> pending, added;
+            std::vector<pollfd> fds;
+            char buffer[64];
+            for(;;) {
+                bool finishing;
+                {
+                    std::lock_guard<std::mutex> lock(outMutex);
+                    added.swap(ready);
+                    finishing = writerStopping;
+                }
+                // A first frame goes out right away, the socket is rarely full
+                for(auto& connection : added) {
+                    if(connection->flush()) {
+                        pending.push_back(std::move(connection));
+                    }
+                }
+                added.clear();
+                if(finishing && pending.empty()) {
+                    return;
+                }
+
+                fds.assign(1, {wakePipe[0], POLLIN, 0});
+                for(const auto& connection : pending) {
+                    fds.push_back({connection->fd, POLLOUT, 0});
+                }
+                int polled = ::poll(fds.data(), fds.size(), finishing ? 1000 : -1);
+                if(polled < 0 && errno != EINTR) {
+                    std::cerr << systemError("Could not wait for the clients").what() << std::endl;
+                    finishing = true;
+                    polled = 0;
+                }
+                if(polled == 0 && finishing) {
+                    for(auto& connection : pending) {
+                        connection->abandon();
+                    }
+                    pending.clear();
+                    continue;
+                }
+                if(fds[0].revents != 0) {
+                    while(::read(wakePipe[0], buffer, sizeof(buffer)) > 0) {}
+                }
+                size_t kept = 0;
+                for(size_t i = 0; i < pending.size(); ++i) {
+                    if(fds[i + 1].revents == 0 || pending[i]->flush()) {
+                        pending[kept++] = std::move(pending[i]);
+                    }
+                }
+                pending.resize(kept);
+            }
+        }
+
+        void reap(std::list<Session>& sessions) {
+            for(auto it = sessions.begin(); it != sessions.end();) {
+                if(*it->done) {
+                    it->thread.join();
+                    it = sessions.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        void read(const std::shared_ptr<Connection>& connection) {
+            Header header;
+            std::string payload;
+            try {
+                while(readFrame(connection->fd, header, payload)) {
+                    // Every request counts until its response is sent, so a
+                    // client that does not read stops being read as well
+                    if(!connection->admit(std::max<size_t>(1, config.inFlight))) {
+                        break;
+                    }
+                    if(header.kind == uint32_t(labeld::RequestKind::Stats)) {
+                        respond(connection, header.tag, labeld::ResponseKind::Stats, stats());
+                        continue;
+                    }
+                    if(header.kind != uint32_t(labeld::RequestKind::Label)) {
+                        respond(connection, header.tag, labeld::ResponseKind::Error,
+                                "unknown request kind " + std::to_string(header.kind));
+                        continue;
+                    }
+                    enqueue({connection, header.tag, std::move(payload)});
+                    payload = std::string();
+                }
+            } catch(const std::exception& e) {
+                // The stream cannot be resynchronized after a broken frame
+                connection->admitFinal();
+                respond(connection, header.tag, labeld::ResponseKind::Error, e.what());
+            }
+            // The connection is closed once the workers answered its
+            // remaining requests and dropped their references
+        }
+
+        void enqueue(Job job) {
+            std::unique_lock<std::mutex> lock(mutex);
+            notFull.wait(lock, [&]() { return jobs.size() < std::max<size_t>(1, config.queue); });
+            jobs.push_back(std::move(job));
+            notEmpty.notify_one();
+        }
+
+        void work() {
+            liblabel::LabelingWorkspace ws;
+            for(;;) {
+                Job job;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    notEmpty.wait(lock, [&]() { return stopping || !jobs.empty(); });
+                    if(jobs.empty()) {
+                        return;
+                    }
+                    job = std::move(jobs.front());
+                    jobs.pop_front();
+                    notFull.notify_one();
+                }
+
+                std::string id;
+                records::Outcome outcome = label(job.payload, ws, id);
+                ++requests;
+                failures += outcome.failed();
+                respond(job.connection, job.tag,
+                        outcome.failed() ? labeld::ResponseKind::Failed : labeld::ResponseKind::Ok,
+                        records::formatOutcome(id, outcome, config.format));
+            }
+        }
+
+        records::Outcome label(const std::string& payload, liblabel::LabelingWorkspace& ws, std::string& id) {
+            records::Outcome outcome;
+            std::istringstream in(payload);
+            auto record = records::readRecord(in);
+            if(!record) {
+                outcome.error = "empty request";
+                return outcome;
+            }
+            id = record->id;
+            if(!record->error.empty()) {
+                outcome.error = record->error;
+                return outcome;
+            }
+            try {
+                outcome.label = cache.computeLabel(record->aspect, record->poly, ws, config.config);
+                outcome.partial = outcome.label && outcome.label->partial;
+            } catch(const std::exception& e) {
+                outcome.label.reset();
+                outcome.error = e.what();
+            } catch(...) {
+                outcome.label.reset();
+                outcome.error = "unknown error";
+            }
+            return outcome;
+        }
+
+        std::string stats() {
+            size_t queued;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                queued = jobs.size();
+            }
+            liblabel::CacheStats cacheStats = cache.stats();
+            std::ostringstream out;
+            out << "{\"requests\": " << requests << ", \"failures\": " << failures
+                << ", \"queued\": " << queued << ", \"connections\": " << connectionsAccepted
+                << ", \"cache\": {\"memory_hits\": " << cacheStats.memoryHits
+                << ", \"disk_hits\": " << cacheStats.diskHits
+                << ", \"misses\": " << cacheStats.misses << "}}";
+            return out.str();
+        }
+
+        const labeld::DaemonConfig& config;
+        liblabel::LabelCache cache;
+
+        std::mutex mutex;
+        std::condition_variable notEmpty, notFull;
+        std::deque<Job> jobs;
+        bool stopping = false;
+
+        // Connections whose first response was queued, for the writer
+        std::mutex outMutex;
+        std::vector<std::shared_ptr<Connection>> ready;
+        bool writerStopping = false;
+        int wakePipe[2] = {-1, -1};
+
+        std::atomic<size_t> requests{0}, failures{0}, connectionsAccepted{0};
+    };
+
+    // Reads the raw text of the next record, see records::readRecord
+    bool readRawRecord(std::istream& in, std::string& text) {
+        text.clear();
+        std::string line;
+        while(std::getline(in, line)) {
+            bool blank = line.find_first_not_of(" \t\r") == std::string::npos;
+            if(blank && !text.empty()) {
+                break;
+            }
+            if(!blank) {
+                text += line;
+                text += '\n';
+            }
+        }
+        return !text.empty();
+    }
+}
+
+void labeld::serve(const DaemonConfig& config) {
+    // Writes to clients that went away fail instead of killing the daemon
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if(::pipe(stopPipe) != 0) {
+        throw systemError("Could not create a pipe");
+    }
+    struct sigaction action{};
+    action.sa_handler = requestStop;
+    sigemptyset(&action.sa_mask);
+    ::sigaction(SIGINT, &action, nullptr);
+    ::sigaction(SIGTERM, &action, nullptr);
+
+    int listenFd = -1;
+    try {
+        listenFd = listenOn(config.socket);
+        Server server(config);
+        server.run(listenFd, stopPipe[0]);
+    } catch(...) {
+        if(listenFd >= 0) {
+            ::close(listenFd);
+            ::unlink(config.socket.c_str());
+        }
+        throw;
+    }
+    ::close(listenFd);
+    ::unlink(config.socket.c_str());
+    std::signal(SIGINT, SIG_DFL);
+    std::signal(SIGTERM, SIG_DFL);
+    ::close(stopPipe[0]);
+    ::close(stopPipe[1]);
+}
+
+size_t labeld::labelRemote(const std::string& socket, std::istream& in, std::ostream& out, size_t window) {
+    std::signal(SIGPIPE, SIG_IGN);
+    int fd = connectTo(socket);
+    if(fd < 0) {
+        throw systemError("Could not connect to " + socket);
+    }
+    window = std::max<size_t>(1, window);
+
+    // The records are sent by a second thread while the responses are read
+    // here. Reading a tied stream would flush out concurrently to the
+    // writes below.
+    std::ostream* tied = in.tie(nullptr);
+    std::mutex mutex;
+    std::condition_variable progress;
+    uint32_t sent = 0, written = 0;
+    bool finished = false, stop = false;
+    std::string sendError;
+
+    std::thread sender([&]() {
+        std::string text;
+        while(readRawRecord(in, text)) {
+            std::unique_lock<std::mutex> lock(mutex);
+            progress.wait(lock, [&]() { return stop || uint32_t(sent - written) < window; });
+            if(stop) {
+                break;
+            }
+            uint32_t tag = sent++;
+            lock.unlock();
+            if(!writeFrame(fd, tag, uint32_t(RequestKind::Label), text)) {
+                std::lock_guard<std::mutex> guard(mutex);
+                sendError = "Could not send to " + socket;
+                break;
+            }
+        }
+        // The daemon answers the remaining requests and closes the connection
+        ::shutdown(fd, SHUT_WR);
+        std::lock_guard<std::mutex> lock(mutex);
+        finished = true;
+    });
+
+    // Responses arrive in the order they are finished and are written in
+    // the order of the records
+    std::map<uint32_t, std::string> pending;
+    size_t failures = 0;
+    std::exception_ptr error;
+    try {
+        Header header;
+        std::string payload;
+        while(readFrame(fd, header, payload)) {
+            if(header.kind == uint32_t(ResponseKind::Error)) {
+                throw std::runtime_error("Daemon error: " + payload);
+            }
+            failures += header.kind == uint32_t(ResponseKind::Failed);
+            pending[header.tag] = std::move(payload);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            for(auto it = pending.find(written); it != pending.end(); it = pending.find(written)) {
+                out << it->second << '\n';
+                pending.erase(it);
+                ++written;
+            }
+            if(written == sent) {
+                // Everything sent so far is answered, the input may be slow
+                out.flush();
+            }
+            progress.notify_all();
+        }
+        out.flush();
+        std::lock_guard<std::mutex> lock(mutex);
+        if(!finished || written != sent) {
+            throw std::runtime_error("The daemon closed the connection early");
+        }
+    } catch(...) {
+        error = std::current_exception();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stop = true;
+    }
+    progress.notify_all();
+    ::shutdown(fd, SHUT_RDWR);
+    sender.join();
+    ::close(fd);
+    in.tie(tied);
+    if(error) {
+        std::rethrow_exception(error);
+    }
+    if(!sendError.empty()) {
+        throw std::runtime_error(sendError);
+    }
+    return failures;
+}
+
+std::string labeld::remoteStats(const std::string& socket) {
+    int fd = connectTo(socket);
+    if(fd < 0) {
+        throw systemError("Could not connect to " + socket);
+    }
+    Header header{};
+    std::string payload;
+    bool ok = writeFrame(fd, 0, uint32_t(RequestKind::Stats), "");
+    try {
+        ok = ok && readFrame(fd, header, payload) && header.kind == uint32_t(ResponseKind::Stats);
+    } catch(...) {
+        ok = false;
+    }
+    ::close(fd);
+    if(!ok) {
+        throw std::runtime_error("No statistics received from " + socket);
+    }
+    return payload;
+}
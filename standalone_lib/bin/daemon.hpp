@@ -0,0 +1,81 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+#include <iostream>
+#include <string>
+
+#include "labelcache.h"
+#include "liblabeling.h"
+#include "record_stream.hpp"
+
+/*
+ * A long running labeling process answering requests on a Unix domain
+ * socket, and the client talking to it.
+ *
+ * Both directions use the same frames: a header of three 32 bit unsigned
+ * integers in network byte order, the payload length, a tag and a kind,
+ * followed by the payload. The tag is chosen by the client and copied into
+ * the response, so a client can send many requests before reading the
+ * responses, which arrive in the order they are finished.
+ *
+ *     request kind 0 (Label):  a record as read by records::readRecord
+ *     request kind 1 (Stats):  empty payload
+ *     response kind 0 (Ok):    the formatted outcome of a record with a label
+ *     response kind 1 (Failed):the formatted outcome of a record without one
+ *     response kind 2 (Stats): counters of the daemon as a JSON object
+ *     response kind 3 (Error): a message, e.g. for an unknown request kind
+ */
+namespace labeld {
+    enum class RequestKind : uint32_t { Label = 0, Stats = 1 };
+    enum class ResponseKind : uint32_t { Ok = 0, Failed = 1, Stats = 2, Error = 3 };
+
+    struct DaemonConfig {
+        // Path of the socket, an existing socket file nobody listens on is
+        // replaced
+        std::string socket;
+
+        // Number of labeling threads, 0 uses one per hardware core
+        size_t threads = 0;
+
+        // Number of accepted requests waiting for a worker. Connections
+        // stop being read while the queue is full.
+        size_t queue = 256;
+
+        // Number of requests of a single connection which are queued, being
+        // labeled or whose response is not sent yet. A client that does not
+        // read its responses stops being read once it reaches the limit, the
+        // responses are sent without blocking the workers. Also bounds the
+        // share of one client.
+        size_t inFlight = 64;
+
+        // Number of open connections, further ones wait to be accepted
+        size_t connections = 64;
+
+        records::Format format = records::Format::NDJSON;
+
+        liblabel::Config config;
+        liblabel::CacheConfig cache;
+    };
+
+    /**
+     * Serves requests until SIGINT or SIGTERM arrives. Requests accepted
+     * before are still answered. Throws std::runtime_error if the socket
+     * cannot be set up.
+     */
+    void serve(const DaemonConfig&);
+
+    /**
+     * Sends the records of in to the daemon listening at socket, keeping up
+     * to window requests in flight, and writes the responses to out in input
+     * order. Returns the number of records without a label. Throws
+     * std::runtime_error if the daemon cannot be reached or hangs up.
+     */
+    size_t labelRemote(const std::string& socket, std::istream& in, std::ostream& out, size_t window = 64);
+
+    /**
+     * Returns the counters of the daemon listening at socket as JSON.
+     */
+    std::string remoteStats(const std::string& socket);
+}
+
+#endif /* DAEMON_HPP */
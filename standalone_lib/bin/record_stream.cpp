@@ -0,0 +1,484 @@
+#include "record_stream.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iomanip>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "labelgeojson.h"
+
+namespace {
+    bool isBlank(const std::string& line) {
+        return line.find_first_not_of(" \t\r") == std::string::npos;
+    }
+
+    // Parses a ring given as a sequence of x y coordinates, a repeated
+    // closing point is dropped
+    bool parseRing(const std::string& line, liblabel::Polyline& ring, std::string& error) {
+        std::istringstream stream(line);
+        std::vector<double> coords;
+        for(double c; stream >> c;) {
+            coords.push_back(c);
+        }
+        if(!stream.eof()) {
+            error = "invalid coordinate in ring";
+            return false;
+        }
+        if(coords.size() % 2 != 0) {
+            error = "odd number of coordinates in ring";
+            return false;
+        }
+        for(size_t i = 0; i < coords.size(); i += 2) {
+            ring.points.push_back({coords[i], coords[i + 1]});
+        }
+        const auto& pts = ring.points;
+        if(pts.size() > 1 && pts.front().x == pts.back().x && pts.front().y == pts.back().y) {
+            ring.points.pop_back();
+        }
+        if(ring.points.size() < 3) {
+            error = "ring with less than 3 points";
+            return false;
+        }
+        return true;
+    }
+
+    std::string jsonString(const std::string& s) {
+        std::ostringstream out;
+        out << '"';
+        for(char c : s) {
+            switch(c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\r': out << "\\r"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c);
+                } else {
+                    out << c;
+                }
+            }
+        }
+        out << '"';
+        return out.str();
+    }
+
+    // TSV fields must not contain tabs or line breaks
+    std::string tsvField(std::string s) {
+        std::replace_if(s.begin(), s.end(), [](char c) { return c == '\t' || c == '\n' || c == '\r'; }, ' ');
+        return s;
+    }
+
+    // Labels the polygon (a Polygon, a PolygonView or a SkeletonGraphView)
+    // unless its record could not be parsed
+    template <class Input>
+    records::Outcome labelPolygon(liblabel::Aspect aspect, const Input& poly, const std::string& error,
+                                  liblabel::LabelingWorkspace& ws, const liblabel::Config& config) {
+        records::Outcome outcome;
+        if(!error.empty()) {
+            outcome.error = error;
+            return outcome;
+        }
+        try {
+            liblabel::LabelStats stats;
+            outcome.label = liblabel::computeLabel(aspect, poly, ws, false, config, &stats);
+            outcome.partial = stats.partial;
+        } catch(const std::exception& e) {
+            outcome.label.reset();
+            outcome.error = e.what();
+        } catch(...) {
+            outcome.label.reset();
+            outcome.error = "unknown error";
+        }
+        return outcome;
+    }
+}
+
+std::string records::formatOutcome(const std::string& id, const Outcome& outcome, Format format) {
+    const char* status = outcome.label.has_value() ? "ok" : outcome.error.empty() ? "no_label" : "error";
+    std::ostringstream out;
+    out << std::setprecision(std::numeric_limits<double>::digits10 + 1);
+
+    if(format == Format::TSV) {
+        out << tsvField(id) << '\t' << status;
+        if(outcome.label.has_value()) {
+            const auto& l = *outcome.label;
+            out << '\t' << l.center.x << '\t' << l.center.y << '\t' << l.rad_lower
+                << '\t' << l.rad_upper << '\t' << l.from << '\t' << l.to;
+        } else {
+            out << "\t\t\t\t\t\t";
+        }
+        out << '\t' << (outcome.partial ? 1 : 0) << '\t' << tsvField(outcome.error);
+        return out.str();
+    }
+
+    out << "{\"id\": " << jsonString(id) << ", \"status\": \"" << status << "\"";
+    if(outcome.label.has_value()) {
+        const auto& l = *outcome.label;
+        out << ", \"label\": {\"center\": [" << l.center.x << ", " << l.center.y << "]"
+            << ", \"rad_lower\": " << l.rad_lower << ", \"rad_upper\": " << l.rad_upper
+            << ", \"from\": " << l.from << ", \"to\": " << l.to << "}";
+    }
+    if(outcome.partial) {
+        out << ", \"partial\": true";
+    }
+    if(!outcome.error.empty()) {
+        out << ", \"error\": " << jsonString(outcome.error);
+    }
+    out << "}";
+    return out.str();
+}
+
+std::optional<records::Record> records::readRecord(std::istream& in) {
+    std::string line;
+    while(std::getline(in, line) && isBlank(line)) {}
+    if(!in) {
+        return {};
+    }
+
+    Record record;
+    std::istringstream header(line);
+    std::string rest;
+    if(!(header >> record.id)) {
+        record.error = "missing record id";
+    } else if(!(header >> record.aspect) || (header >> rest)) {
+        record.error = "expected '<id> <aspect>' as first line";
+    }
+
+    // The rings are consumed even if the header was broken, so the next
+    // record starts at the right line
+    bool outer = true;
+    while(std::getline(in, line) && !isBlank(line)) {
+        if(!record.error.empty()) {
+            continue;
+        }
+        liblabel::Polyline ring;
+        if(parseRing(line, ring, record.error)) {
+            if(outer) {
+                record.poly.outer = std::move(ring);
+            } else {
+                record.poly.holes.push_back(std::move(ring));
+            }
+        }
+        outer = false;
+    }
+    if(outer && record.error.empty()) {
+        record.error = "missing outer boundary";
+    }
+    if(!record.error.empty()) {
+        record.poly = liblabel::Polygon();
+    }
+    return record;
+}
+
+namespace {
+    // Unties the input stream while it is read concurrently to the writer,
+    // reading a tied stream flushes the output which would race with it
+    class Untied {
+    public:
+        explicit Untied(std::istream& in) : in(in), tied(in.tie(nullptr)) {}
+        ~Untied() { in.tie(tied); }
+
+    private:
+        std::istream& in;
+        std::ostream* tied;
+    };
+
+    // Per thread memory of the labeling workers
+    struct Worker {
+        liblabel::LabelingWorkspace ws;
+        liblabel::Polygon poly;
+    };
+
+    liblabel::Aspect aspectOf(liblabel::Aspect recordAspect, const records::StreamConfig& config) {
+        return config.aspect > 0 ? config.aspect : recordAspect;
+    }
+
+    /*
+     * Runs the labeling pipeline: read() returns the next item or nothing at
+     * the end of the input and is called from the calling thread only.
+     * label(item, worker) returns the result of the item and whether it
+     * failed, it is called concurrently by the workers. emit(result) gets
+     * the results in input order from a single thread, flush() is called
+     * whenever it waits for the next one. An exception of read() is
+     * rethrown once the items before it are emitted.
+     */
+    template <class Item, class Result, class Read, class Label, class Emit, class Flush>
+    size_t runPipeline(const records::StreamConfig& streamConfig, Read read, Label label, Emit emit, Flush flush) {
+        size_t threads = streamConfig.threads > 0 ? streamConfig.threads
+                                                  : std::max<size_t>(1, std::thread::hardware_concurrency());
+        size_t window = streamConfig.window > 0 ? streamConfig.window : 4 * threads;
+
+        struct Slot {
+            Item item;
+            Result result;
+            bool failed = false;
+            bool done = false;
+        };
+
+        // The slots are the items in flight in input order, the front one is
+        // written next. References into a deque stay valid on push_back and
+        // pop_front, so workers fill their slot without holding the lock.
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::deque<Slot> slots;
+        size_t first = 0;           // sequence number of slots.front()
+        size_t next = 0;            // sequence number of the next item to label
+        bool finished = false;      // all items are read
+        size_t failures = 0;
+
+        auto work = [&]() {
+            Worker worker;
+            std::unique_lock<std::mutex> lock(mutex);
+            for(;;) {
+                changed.wait(lock, [&]() { return next < first + slots.size() || finished; });
+                if(next == first + slots.size()) {
+                    return;
+                }
+                Slot& slot = slots[next++ - first];
+                Item item = std::move(slot.item);
+                lock.unlock();
+
+                auto [result, failed] = label(item, worker);
+
+                lock.lock();
+                slot.result = std::move(result);
+                slot.failed = failed;
+                slot.done = true;
+                changed.notify_all();
+            }
+        };
+
+        auto write = [&]() {
+            std::unique_lock<std::mutex> lock(mutex);
+            for(;;) {
+                if(slots.empty() || !slots.front().done) {
+                    // Nothing to write right now, hand the lines written so far on
+                    lock.unlock();
+                    flush();
+                    lock.lock();
+                }
+                changed.wait(lock, [&]() { return (!slots.empty() && slots.front().done) || (finished && slots.empty()); });
+                if(slots.empty()) {
+                    return;
+                }
+                Result result = std::move(slots.front().result);
+                failures += slots.front().failed;
+                slots.pop_front();
+                ++first;
+                changed.notify_all();
+
+                lock.unlock();
+                emit(result);
+                lock.lock();
+            }
+        };
+
+        std::vector<std::thread> workers;
+        for(size_t i = 0; i < threads; ++i) {
+            workers.emplace_back(work);
+        }
+        std::thread writer(write);
+
+        // A failing read ends the input, the items read so far are still written
+        std::exception_ptr error;
+        try {
+            while(auto item = read()) {
+                std::unique_lock<std::mutex> lock(mutex);
+                changed.wait(lock, [&]() { return slots.size() < window; });
+                slots.push_back({std::move(*item)});
+                changed.notify_all();
+            }
+        } catch(...) {
+            error = std::current_exception();
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        changed.notify_all();
+
+        for(auto& t : workers) {
+            t.join();
+        }
+        writer.join();
+        flush();
+        if(error) {
+            std::rethrow_exception(error);
+        }
+        return failures;
+    }
+
+    // Runs the pipeline with the output lines of the items as results
+    template <class Item, class Read, class Label>
+    size_t runPipeline(std::ostream& out, const records::StreamConfig& streamConfig, Read read, Label label) {
+        return runPipeline<Item, std::string>(streamConfig, read, label,
+            [&out](const std::string& line) { out << line << '\n'; },
+            [&out]() { out.flush(); });
+    }
+}
+
+size_t records::labelRecords(std::istream& in, std::ostream& out, const StreamConfig& streamConfig) {
+    Untied untied(in);
+    return runPipeline<Record>(out, streamConfig,
+        [&in]() { return readRecord(in); },
+        [&streamConfig](const Record& record, Worker& worker) {
+            Outcome outcome = labelPolygon(aspectOf(record.aspect, streamConfig), record.poly, record.error, worker.ws, streamConfig.config);
+            return std::make_pair(formatOutcome(record.id, outcome, streamConfig.format), outcome.failed());
+        });
+}
+
+size_t records::labelCorpus(const liblabel::CorpusReader& corpus, std::ostream& out, const StreamConfig& streamConfig) {
+    size_t read = 0;
+    return runPipeline<size_t>(out, streamConfig,
+        [&]() { return read < corpus.size() ? std::optional<size_t>(read++) : std::nullopt; },
+        [&](size_t index, Worker& worker) {
+            auto record = corpus[index];
+            liblabel::Aspect aspect = aspectOf(record.aspect(), streamConfig);
+            Outcome outcome;
+            if(auto view = record.polygonView()) {
+                outcome = labelPolygon(aspect, *view, "", worker.ws, streamConfig.config);
+            } else {
+                record.toPolygon(worker.poly);
+                outcome = labelPolygon(aspect, worker.poly, "", worker.ws, streamConfig.config);
+            }
+            return std::make_pair(formatOutcome(std::string(record.id()), outcome, streamConfig.format), outcome.failed());
+        });
+}
+
+size_t records::labelSkeletonStore(const liblabel::SkeletonStoreReader& store, std::ostream& out, const StreamConfig& streamConfig) {
+    size_t read = 0;
+    return runPipeline<size_t>(out, streamConfig,
+        [&]() { return read < store.size() ? std::optional<size_t>(read++) : std::nullopt; },
+        [&](size_t index, Worker& worker) {
+            auto record = store[index];
+            // A record without a skeleton has no label, as in computeLabel
+            Outcome outcome;
+            if(record.hasSkeleton()) {
+                outcome = labelPolygon(aspectOf(record.aspect(), streamConfig), record.graph(), "", worker.ws, streamConfig.config);
+            }
+            return std::make_pair(formatOutcome(std::string(record.id()), outcome, streamConfig.format), outcome.failed());
+        });
+}
+
+size_t records::precomputeSkeletons(const liblabel::CorpusReader& corpus, liblabel::SkeletonStoreWriter& store, const StreamConfig& streamConfig) {
+    struct Result {
+        size_t index = 0;
+        liblabel::SkeletonGraph graph;
+        std::string error;
+    };
+
+    size_t read = 0;
+    std::exception_ptr error;
+    size_t missing = runPipeline<size_t, Result>(streamConfig,
+        [&]() { return read < corpus.size() ? std::optional<size_t>(read++) : std::nullopt; },
+        [&](size_t index, Worker& worker) {
+            Result result;
+            result.index = index;
+            bool computed = false;
+            try {
+                corpus[index].toPolygon(worker.poly);
+                computed = liblabel::computeSkeleton(worker.poly, result.graph, worker.ws, streamConfig.config);
+            } catch(const std::exception& e) {
+                result.error = e.what();
+            }
+            if(!computed && result.error.empty()) {
+                result.error = "no skeleton";
+            }
+            return std::make_pair(std::move(result), !computed);
+        },
+        [&](const Result& result) {
+            if(error) {
+                return;
+            }
+            auto record = corpus[result.index];
+            try {
+                if(result.error.empty()) {
+                    store.add(record.id(), record.aspect(), result.graph);
+                } else {
+                    std::cerr << "Record " << record.id() << ": " << result.error << std::endl;
+                    store.addMissing(record.id(), record.aspect());
+                }
+            } catch(...) {
+                error = std::current_exception();
+            }
+        },
+        []() {});
+    if(error) {
+        std::rethrow_exception(error);
+    }
+    return missing;
+}
+
+size_t records::labelGeoJson(std::istream& in, std::ostream& out, const StreamConfig& streamConfig) {
+    struct Item {
+        size_t index;
+        liblabel::GeoJsonFeature feature;
+    };
+    // The failures are reported by the writer, in order and off the workers
+    struct Line {
+        size_t index;
+        std::string json;
+        std::string failure;
+    };
+
+    Untied untied(in);
+    liblabel::GeoJsonReader reader(in);
+    size_t read = 0;
+
+    out << "{\"type\": \"FeatureCollection\", \"features\": [\n";
+    size_t failures = 0;
+    try {
+        failures = runPipeline<Item, Line>(streamConfig,
+            [&]() {
+                Item item{read, {}};
+                if(!reader.next(item.feature)) {
+                    return std::optional<Item>();
+                }
+                ++read;
+                return std::optional<Item>(std::move(item));
+            },
+            [&](const Item& item, Worker& worker) {
+                const liblabel::GeoJsonFeature& feature = item.feature;
+                Line line{item.index, item.index > 0 ? "," : "", ""};
+                const liblabel::Polygon* poly = feature.largestPolygon();
+                Outcome outcome;
+                if(!feature.error.empty()) {
+                    outcome.error = feature.error;
+                } else if(poly == nullptr) {
+                    // Features without an area are passed through
+                    line.json += feature.json;
+                    return std::make_pair(line, false);
+                } else if(feature.text.empty()) {
+                    outcome.error = "no label text";
+                } else {
+                    outcome = labelPolygon(feature.aspect(), *poly, "", worker.ws, streamConfig.config);
+                }
+                if(outcome.failed()) {
+                    line.failure = outcome.error.empty() ? "no label found" : outcome.error;
+                }
+                line.json += liblabel::labeledFeature(feature, outcome.label);
+                return std::make_pair(line, outcome.failed());
+            },
+            [&out](const Line& line) {
+                out << line.json << '\n';
+                if(!line.failure.empty()) {
+                    std::cerr << "Feature " << line.index << ": " << line.failure << std::endl;
+                }
+            },
+            [&out]() { out.flush(); });
+    } catch(...) {
+        // The features written so far stay a valid document
+        out << "]}" << std::endl;
+        throw;
+    }
+    out << "]}" << std::endl;
+    return failures;
+}
@@ -0,0 +1,115 @@
+#ifndef RECORD_STREAM_HPP
+#define RECORD_STREAM_HPP
+
+#include <iostream>
+#include <optional>
+#include <string>
+
+#include "labelcorpus.h"
+#include "labelskeleton.h"
+#include "liblabeling.h"
+
+namespace records {
+    enum class Format { NDJSON, TSV };
+
+    struct StreamConfig {
+        // Number of labeling threads, 0 uses one per hardware core
+        size_t threads = 0;
+
+        // Maximal number of records read but not yet written,
+        // 0 uses four per thread
+        size_t window = 0;
+
+        Format format = Format::NDJSON;
+
+        // Replaces the aspects of the records if positive, e.g. to label
+        // stored skeletons for another text
+        liblabel::Aspect aspect = 0;
+
+        liblabel::Config config;
+    };
+
+    struct Record {
+        std::string id;
+        liblabel::Aspect aspect = 0;
+        liblabel::Polygon poly;
+
+        // Set if the record could not be parsed, it is reported as failed
+        std::string error;
+    };
+
+    /**
+     * Result of labeling a record. failed() holds if there is no label,
+     * error tells why if the labeling did not just find none.
+     */
+    struct Outcome {
+        std::optional<liblabel::AreaLabel> label;
+        bool partial = false;
+        std::string error;
+
+        bool failed() const { return !label.has_value(); }
+    };
+
+    /**
+     * Formats the output line of a record (without the line break):
+     *
+     *     NDJSON: {"id": ..., "status": "ok"|"no_label"|"error", ...}
+     *     TSV:    id status center_x center_y rad_lower rad_upper from to partial error
+     */
+    std::string formatOutcome(const std::string& id, const Outcome&, Format);
+
+    /**
+     * Reads the next record, records are separated by empty lines:
+     *
+     *     <id> <aspect>
+     *     <x y coordinates of the outer boundary>
+     *     <x y coordinates of a hole>
+     *     ...
+     *
+     * Returns nothing at the end of the input.
+     */
+    std::optional<Record> readRecord(std::istream&);
+
+    /**
+     * Labels the records of in with several threads and writes one line per
+     * record to out, in input order. Records which cannot be parsed or
+     * labeled are reported in their line. Returns the number of records
+     * without a label.
+     */
+    size_t labelRecords(std::istream& in, std::ostream& out, const StreamConfig&);
+
+    /**
+     * Labels all records of a binary corpus like labelRecords. The workers
+     * label the records straight from the mapped file, records of a
+     * quantized corpus are decoded first.
+     */
+    size_t labelCorpus(const liblabel::CorpusReader& corpus, std::ostream& out, const StreamConfig&);
+
+    /**
+     * Labels all records of a skeleton store like labelRecords, straight
+     * from the mapped graphs without building polygons or skeletons.
+     */
+    size_t labelSkeletonStore(const liblabel::SkeletonStoreReader& store, std::ostream& out, const StreamConfig&);
+
+    /**
+     * Computes the skeletons of all records of a corpus with several threads
+     * and adds them to the store in corpus order, with the config of
+     * streamConfig. Records without a skeleton are added as missing and
+     * reported on stderr. Returns their number.
+     */
+    size_t precomputeSkeletons(const liblabel::CorpusReader& corpus, liblabel::SkeletonStoreWriter& store, const StreamConfig&);
+
+    /**
+     * Labels the Polygon and MultiPolygon features of a GeoJSON document
+     * like labelRecords and writes them as a FeatureCollection with the
+     * label in properties.label.baseline. The aspect follows from the label
+     * text, a MultiPolygon is labeled in its largest part. Other features
+     * are passed through. Features that got no label are reported on
+     * stderr and counted. If reading the input fails, the features before
+     * the error are written, the collection is closed and the error is
+     * rethrown.
+     */
+    size_t labelGeoJson(std::istream& in, std::ostream& out, const StreamConfig&);
+}
+
+#endif /* RECORD_STREAM_HPP */
@@ -0,0 +1,53 @@
+#include <algorithm>
+#include <exception>
+
+#include "labelcache.h"
+#include "liblabeling.h"
+#include "thread_pool.hpp"
+
+std::vector<liblabel::LabelResult> liblabel::computeLabels(
+        const liblabel::LabelJob* jobs,
+        size_t count,
+        liblabel::BatchConfig batchConfig
+    ){
+    std::vector<LabelResult> results(count);
+    size_t threads = std::min(detail::resolveThreadCount(batchConfig.threads), std::max<size_t>(count, 1));
+
+    std::vector<LabelingWorkspace> workspaces(threads);
+
+    detail::ThreadPool pool(threads - 1);
+    pool.parallelFor(count, [&](size_t i, size_t worker) {
+        const LabelJob& job = jobs[i];
+        try {
+            if(job.view) {
+                results[i].label = computeLabel(job.aspect, *job.view, workspaces[worker], false, job.config, &results[i].stats);
+                return;
+            }
+            CacheKey key{};
+            if(batchConfig.cache) {
+                key = cacheKey(job.aspect, *job.polygon, job.config);
+                if(auto entry = batchConfig.cache->find(key)) {
+                    results[i].label = *entry;
+                    return;
+                }
+            }
+            results[i].label = computeLabel(job.aspect, *job.polygon, workspaces[worker], false, job.config, &results[i].stats);
+            if(batchConfig.cache && !results[i].stats.partial) {
+                batchConfig.cache->insert(key, results[i].label);
+            }
+        } catch(const std::exception& e) {
+            results[i].error = e.what();
+        } catch(...) {
+            results[i].error = "unknown error";
+        }
+    });
+
+    return results;
+}
+
+std::vector<liblabel::LabelResult> liblabel::computeLabels(
+        const std::vector<liblabel::LabelJob>& jobs,
+        liblabel::BatchConfig batchConfig
+    ){
+    return computeLabels(jobs.data(), jobs.size(), batchConfig);
+}
@@ -0,0 +1,86 @@
+#ifndef LABELCACHE_H
+#define LABELCACHE_H
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "liblabeling.h"
+
+namespace liblabel {
+    struct CacheConfig {
+        // Number of labels kept in memory, least recently used ones are
+        // evicted first. 0 disables the in-memory tier.
+        size_t capacity = 4096;
+
+        // Folder of the persistent tier, empty disables it. The folder is
+        // created if necessary and may be shared by several processes.
+        std::string directory;
+    };
+
+    struct CacheStats {
+        size_t memoryHits = 0;
+        size_t diskHits = 0;
+        size_t misses = 0;
+    };
+
+    /**
+     * Content address of a labeling request: a 128 bit hash of the polygon,
+     * the aspect and the parameters of the config that influence the label.
+     */
+    struct CacheKey {
+        uint64_t high, low;
+
+        bool operator==(const CacheKey& o) const { return high == o.high && low == o.low; }
+    };
+
+    /**
+     * Computes the cache key of a labeling request. The rings are hashed
+     * with their vertices in the given order, since the label may depend on
+     * the start vertex of a ring, a repeated closing vertex and the order of
+     * the holes.
+     */
+    CacheKey cacheKey(Aspect, const Polygon&, const Config&);
+
+    /**
+     * A cache in front of computeLabel. Labels are looked up in memory first,
+     * then on disk, and only computed if both tiers miss. Polygons for which
+     * no label exists are cached as well. Partial results of a call that ran
+     * out of its time budget are not cached.
+     *
+     * Thread safety: all member functions may be called concurrently. Two
+     * threads missing the same key at the same time both compute the label.
+     */
+    class LabelCache {
+    public:
+        explicit LabelCache(CacheConfig = CacheConfig());
+        ~LabelCache();
+
+        LabelCache(const LabelCache&) = delete;
+        LabelCache& operator=(const LabelCache&) = delete;
+
+        std::optional<liblabel::AreaLabel> computeLabel( liblabel::Aspect,
+                                                         const liblabel::Polygon&,
+                                                         liblabel::Config = liblabel::Config() );
+
+        std::optional<liblabel::AreaLabel> computeLabel( liblabel::Aspect,
+                                                         const liblabel::Polygon&,
+                                                         liblabel::LabelingWorkspace&,
+                                                         liblabel::Config = liblabel::Config() );
+
+        // Looks the key up without computing anything on a miss. The outer
+        // optional is empty on a miss, the inner one if no label exists.
+        std::optional<std::optional<liblabel::AreaLabel>> find(const CacheKey&);
+
+        void insert(const CacheKey&, const std::optional<liblabel::AreaLabel>&);
+
+        CacheStats stats() const;
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl;
+    };
+}
+
+#endif /* LABELCACHE_H */
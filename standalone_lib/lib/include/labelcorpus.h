@@ -0,0 +1,125 @@
+#ifndef LABELCORPUS_H
+#define LABELCORPUS_H
+
+#include <cstdint>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "liblabeling.h"
+
+namespace liblabel {
+    /**
+     * Binary polygon corpus. All numbers are little endian and every section
+     * starts at a multiple of 8 bytes:
+     *
+     *     header       magic, version, flags, counts and section offsets
+     *     coordinates  x y pairs of all rings, as doubles or, in a quantized
+     *                  corpus, as int32 relative to the origin of the record
+     *     rings        uint64 index of the first point of every ring,
+     *                  followed by the total number of points
+     *     records      aspect, origin, scale, first ring, ring count and id
+     *                  location of every record
+     *     ids          the concatenated record ids
+     *
+     * The first ring of a record is its outer boundary, the others are holes.
+     */
+
+    class CorpusReader;
+
+    // A record of a mapped corpus, valid as long as its reader
+    class CorpusRecordView {
+    public:
+        std::string_view id() const;
+        Aspect aspect() const;
+
+        // Number of rings, the outer boundary and the holes
+        size_t rings() const;
+        size_t ringSize(size_t ring) const;
+        Point point(size_t ring, size_t i) const;
+
+        // Fills poly with the rings of the record, reusing its memory
+        void toPolygon(Polygon& poly) const;
+
+        // A view of the record straight into the mapped file, only possible
+        // if the corpus is not quantized
+        std::optional<PolygonView> polygonView() const;
+
+    private:
+        friend class CorpusReader;
+        const CorpusReader* reader;
+        size_t index;
+    };
+
+    /**
+     * Maps a corpus file into memory. Records are decoded on access, only
+     * the pages touched are read from disk. Throws std::runtime_error if the
+     * file cannot be mapped or is not a valid corpus.
+     *
+     * Thread safety: a reader may be used from many threads at once.
+     */
+    class CorpusReader {
+    public:
+        explicit CorpusReader(const std::string& path);
+        ~CorpusReader();
+
+        CorpusReader(const CorpusReader&) = delete;
+        CorpusReader& operator=(const CorpusReader&) = delete;
+
+        size_t size() const { return recordCount; }
+        bool quantized() const { return isQuantized; }
+
+        CorpusRecordView operator[](size_t record) const;
+
+    private:
+        friend class CorpusRecordView;
+
+        const unsigned char* data = nullptr;
+        size_t length = 0;
+        size_t recordCount = 0;
+        bool isQuantized = false;
+
+        const void* coordinates = nullptr;
+        const uint64_t* ringStarts = nullptr;
+        const void* records = nullptr;
+        const char* ids = nullptr;
+    };
+
+    /**
+     * Writes a corpus file. The coordinates are streamed to disk, only the
+     * ring and record tables are kept in memory until finish(). Quantized
+     * corpora store every coordinate as int32 relative to the lower left
+     * corner of its record, which halves the size at a relative error of
+     * about 5e-10 of the record extent. Throws std::runtime_error on I/O
+     * errors.
+     */
+    class CorpusWriter {
+    public:
+        CorpusWriter(const std::string& path, bool quantize);
+        ~CorpusWriter();
+
+        CorpusWriter(const CorpusWriter&) = delete;
+        CorpusWriter& operator=(const CorpusWriter&) = delete;
+
+        void add(std::string_view id, Aspect, const Polygon&);
+
+        // Writes the tables and the header, no records can be added afterwards
+        void finish();
+
+    private:
+        void writeRing(const Polyline&, double originX, double originY, double scale);
+
+        std::ofstream out;
+        bool quantize;
+        bool finished = false;
+        uint64_t points = 0;
+        std::vector<uint64_t> ringStarts;
+        // The encoded record table
+        std::string entries;
+        std::string ids;
+    };
+}
+
+#endif /* LABELCORPUS_H */
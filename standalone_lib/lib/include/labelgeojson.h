@@ -0,0 +1,97 @@
+#ifndef LABELGEOJSON_H
+#define LABELGEOJSON_H
+
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "liblabeling.h"
+
+namespace liblabel {
+    /**
+     * The aspect of a label text as used by the web gui: 1.63 divided by
+     * the number of characters of the UTF-8 encoded text.
+     */
+    Aspect textAspect(std::string_view text);
+
+    /**
+     * A feature read from a GeoJSON document.
+     */
+    struct GeoJsonFeature {
+        // The JSON text of the feature as it was read
+        std::string json;
+
+        // The parts of a Polygon or MultiPolygon geometry without the
+        // repeated closing points, empty for other geometries
+        std::vector<Polygon> polygons;
+
+        // The label text, taken from properties.label.label (a string or an
+        // array of strings joined by spaces, as in data/data.json) or else
+        // from properties.name. Empty if there is none.
+        std::string text;
+
+        // Set if the feature could not be parsed
+        std::string error;
+
+        // The part with the largest area, which is the one to label
+        const Polygon* largestPolygon() const;
+
+        Aspect aspect() const { return textAspect(text); }
+
+    private:
+        friend class GeoJsonReader;
+        friend std::string labeledFeature(const GeoJsonFeature&, const std::optional<AreaLabel>&);
+
+        // Text ranges of the members of the feature object in json
+        std::vector<std::pair<size_t, size_t>> members;
+        // Index of the properties member, members.size() if there is none
+        size_t properties = 0;
+    };
+
+    /**
+     * Streams the features of a GeoJSON document, which may be a
+     * FeatureCollection, an array of features or a single feature. Only one
+     * feature is held in memory at a time. Throws std::runtime_error if the
+     * document itself is malformed; a malformed feature only sets its error.
+     */
+    class GeoJsonReader {
+    public:
+        explicit GeoJsonReader(std::istream& in);
+
+        // Reads the next feature, returns false at the end of the document
+        bool next(GeoJsonFeature& feature);
+
+    private:
+        enum class State { Start, Features, Done };
+
+        int peek();
+        int get();
+        void skipWhitespace();
+        void expect(char c);
+        std::string readString();
+        // Appends the text of the next value to out
+        void captureValue(std::string& out);
+        void parse(GeoJsonFeature& feature);
+
+        std::streambuf* buffer;
+        State state = State::Start;
+        bool topLevelObject = false;
+        // Members of a top level object read before its features
+        std::string pendingMembers;
+    };
+
+    /**
+     * The JSON text of the feature with the label stored as
+     * properties.label.baseline, in the form the web gui reads:
+     * {"center": [x, y], "radius": r, "from": a, "to": b} where the radius
+     * is the baseline of text drawn into the label, plus the radii
+     * rad_lower and rad_upper of the label. Without a label the feature is
+     * returned unchanged.
+     */
+    std::string labeledFeature(const GeoJsonFeature&, const std::optional<AreaLabel>&);
+}
+
+#endif /* LABELGEOJSON_H */
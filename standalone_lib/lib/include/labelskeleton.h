@@ -0,0 +1,151 @@
+#ifndef LABELSKELETON_H
+#define LABELSKELETON_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "liblabeling.h"
+
+namespace liblabel {
+    /**
+     * Binary store of skeleton graphs (see SkeletonGraph), e.g. computed
+     * once for a corpus and labeled many times with other aspects. All
+     * numbers are little endian and every section starts at a multiple of
+     * 8 bytes:
+     *
+     *     header       magic, version, the config the skeletons were
+     *                  computed with, counts and section offsets
+     *     boundary     x y doubles of the subsampled rings of all records
+     *     rings        uint64 index of the first point of every ring,
+     *                  followed by the total number of points
+     *     nodes        x y doubles of the skeleton nodes of all records
+     *     arc starts   uint64 index of the first arc of every node,
+     *                  followed by the total number of arcs
+     *     arcs         uint32 node and uint32 edge of every arc, both
+     *                  counted from the first of their record
+     *     edges        weight and capacity doubles of every edge
+     *     records      aspect, largest clearance, first ring, ring count,
+     *                  first node, node count, first edge, edge count and
+     *                  id location of every record
+     *     ids          the concatenated record ids
+     *
+     * A record whose skeleton could not be computed has no rings. Node and
+     * edge indices are local to their record, ring and arc starts are
+     * global, so a record is viewed in place without copying.
+     *
+     * A store is a snapshot and is never updated, it has to be written
+     * again when
+     *   - the corpus changes: the records are copied (id, aspect) at
+     *     precompute time and nothing ties the store to the corpus file,
+     *   - the construction parameters change: the header keeps
+     *     vertexBudget, sampling, skeleton and simplifyTolerance, and a
+     *     store is only valid for labeling with these (labeling -K applies
+     *     them, library users pass them via config()),
+     *   - the reader rejects it: the version is bumped whenever the layout
+     *     or the skeletons computed for the same parameters change, and a
+     *     store of the other byte order is rejected as well.
+     * Aspects and all parameters of the path search and the evaluation may
+     * differ between labeling runs of the same store.
+     */
+
+    class SkeletonStoreReader;
+
+    // A record of a mapped store, valid as long as its reader
+    class SkeletonRecordView {
+    public:
+        std::string_view id() const;
+        Aspect aspect() const;
+
+        // false for records added by SkeletonStoreWriter::addMissing
+        bool hasSkeleton() const;
+
+        // A view straight into the mapped file
+        SkeletonGraphView graph() const;
+
+    private:
+        friend class SkeletonStoreReader;
+        const SkeletonStoreReader* reader;
+        size_t index;
+    };
+
+    /**
+     * Maps a skeleton store into memory, only the pages touched are read
+     * from disk. Throws std::runtime_error if the file cannot be mapped or
+     * is not a valid store.
+     *
+     * Thread safety: a reader may be used from many threads at once.
+     */
+    class SkeletonStoreReader {
+    public:
+        explicit SkeletonStoreReader(const std::string& path);
+        ~SkeletonStoreReader();
+
+        SkeletonStoreReader(const SkeletonStoreReader&) = delete;
+        SkeletonStoreReader& operator=(const SkeletonStoreReader&) = delete;
+
+        size_t size() const { return recordCount; }
+
+        // The config the skeletons were computed with. Only the parameters
+        // of the polygon and skeleton construction are stored, the others
+        // have their defaults.
+        const Config& config() const { return storedConfig; }
+
+        SkeletonRecordView operator[](size_t record) const;
+
+    private:
+        friend class SkeletonRecordView;
+
+        const unsigned char* data = nullptr;
+        size_t length = 0;
+        size_t recordCount = 0;
+        Config storedConfig;
+
+        const Point* boundary = nullptr;
+        const uint64_t* ringStarts = nullptr;
+        const Point* nodes = nullptr;
+        const uint64_t* arcStarts = nullptr;
+        const SkeletonArc* arcs = nullptr;
+        const SkeletonEdgeData* edges = nullptr;
+        const void* records = nullptr;
+        const char* ids = nullptr;
+    };
+
+    /**
+     * Writes a skeleton store. Every section is streamed to a temporary
+     * file next to the store, finish() concatenates them behind the header.
+     * Throws std::runtime_error on I/O errors.
+     */
+    class SkeletonStoreWriter {
+    public:
+        // config is the one the skeletons are computed with
+        SkeletonStoreWriter(const std::string& path, const Config& config);
+        ~SkeletonStoreWriter();
+
+        SkeletonStoreWriter(const SkeletonStoreWriter&) = delete;
+        SkeletonStoreWriter& operator=(const SkeletonStoreWriter&) = delete;
+
+        void add(std::string_view id, Aspect, const SkeletonGraph&);
+
+        // Adds a record without a skeleton
+        void addMissing(std::string_view id, Aspect);
+
+        // Writes the tables and the header, no records can be added afterwards
+        void finish();
+
+    private:
+        struct Section;
+
+        std::string path;
+        Config config;
+        bool finished = false;
+        std::vector<Section> sections;
+        uint64_t points = 0, rings = 0, nodes = 0, arcs = 0, edges = 0;
+        // The encoded record table
+        std::string entries;
+        std::string ids;
+    };
+}
+
+#endif /* LABELSKELETON_H */
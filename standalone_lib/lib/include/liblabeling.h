@@ -1,7 +1,10 @@
 #ifndef LIBLABELING_H
 #define LIBLABELING_H
 
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <string>
 #include <vector>
 
 namespace liblabel {
@@ -39,12 +42,94 @@ namespace liblabel {
         std::vector<Polyline> holes;
     };
 
+    /**
+     * A non-owning view of a polygon in flat buffers, e.g. columns of a
+     * table, which is labeled without copying it into a Polygon first.
+     * The buffers have to outlive the call they are passed to.
+     */
+    struct PolygonView {
+        // Point i is (x[i * stride], y[i * stride]). Interleaved coordinates
+        // x0 y0 x1 y1 ... use y = x + 1 and stride 2, separate x and y
+        // columns stride 1.
+        const double* x;
+        const double* y;
+        size_t stride;
+
+        // Ring r consists of the points ringOffsets[r] to ringOffsets[r+1]-1,
+        // so there are ringCount + 1 offsets, which must not decrease, and x
+        // and y hold at least ringOffsets[ringCount] points. Ring 0 is the
+        // outer boundary, the others are holes. As in a Polygon the last
+        // point of a ring is connected to the first one.
+        const size_t* ringOffsets;
+        size_t ringCount;
+    };
+
     struct Config {
         // Step size during the longest path search
         double stepSize = 2.;
 
         // Number of alternative longest paths to consider
         size_t numberOfPaths = 20;
+
+        // Number of vertices the outer ring is subsampled to before the
+        // skeleton is computed. The holes are sampled as densely, so they
+        // add vertices beyond the budget.
+        size_t vertexBudget = 100;
+
+        // Uniform places the samples in equal distances along the boundary.
+        // Adaptive spends them where the polygon is narrow, judged by the
+        // clearance of the skeleton of the input, at the cost of a second
+        // triangulation.
+        enum class Sampling { Uniform, Adaptive };
+        Sampling sampling = Sampling::Uniform;
+
+        // ConformingCDT approximates the medial axis by the Voronoi diagram
+        // of the subsampled boundary, made conforming by Steiner points.
+        // SegmentVoronoi computes the medial axis of the boundary segments
+        // themselves with exact clearances. It needs no subsampling,
+        // vertexBudget only scales simplifyTolerance and sampling is ignored.
+        // It pays off for polygons with long straight edges or narrow parts.
+        enum class Skeleton { ConformingCDT, SegmentVoronoi };
+        Skeleton skeleton = Skeleton::ConformingCDT;
+
+        // CGAL kernel of the path evaluation (cups, high points and the
+        // point in polygon tests of the placements). ExactPredicates uses
+        // filtered predicates, Fast plain double arithmetic, which skips the
+        // filters but may misjudge placements within rounding errors of the
+        // boundary. The skeleton is always built with exact predicates.
+        enum class Kernel { ExactPredicates, Fast };
+        Kernel kernel = Kernel::ExactPredicates;
+
+        // Rings are simplified (Douglas-Peucker) before the subsampling if
+        // positive: vertices closer than simplifyTolerance times the sample
+        // spacing to the simplified ring are dropped. Meant for inputs with
+        // thousands of vertices, 0 disables the simplification.
+        double simplifyTolerance = 0;
+
+        // Number of threads evaluating the candidate paths of a single label,
+        // 0 uses one thread per hardware core. The result does not depend on
+        // it. Keep it at 1 when labeling a batch to avoid oversubscription.
+        size_t evaluationThreads = 1;
+
+        // Compact the skeleton graph before the path search: spurs that stay
+        // within the largest empty circle at their branch vertex are pruned
+        // and chains of degree 2 vertices are contracted into single edges
+        // with the smallest capacity of the chain. Paths then end at branch
+        // vertices and leaves only, but the searches visit far fewer
+        // vertices. Spurs are pruned by their clearance alone, independent
+        // of the aspect ratio. Off until its effect on the label quality is
+        // measured, see the compaction benchmark.
+        bool compactSkeleton = false;
+
+        // Skip candidate paths whose upper bound of the label height cannot
+        // beat the best label found so far. The result does not depend on it.
+        bool pruneCandidates = true;
+
+        // Time budget of a call in seconds, 0 is unlimited. When the budget
+        // is used up the labeling stops and returns the best label found so
+        // far, marked as partial. The skeleton construction is interrupted
+        // as well, so a partial result may also be no label at all.
+        double timeBudget = 0;
     };
 
     struct AreaLabel {
@@ -55,12 +140,251 @@ namespace liblabel {
         // label starts at angle <from> and goes to <to>
         // both angles are in degrees where 0 is the direction of the x axis
         double from, to;
+        // true if the time budget ran out before all candidates were
+        // evaluated, a complete run may find a larger label
+        bool partial = false;
+    };
+
+    /**
+     * Measurements of a single computeLabel call. Stages that were not
+     * reached (e.g. because no skeleton could be built) are reported as 0.
+     */
+    struct LabelStats {
+        // Wall times of the stages in seconds
+        double polygonSeconds = 0;      // polygon construction and subsampling
+        double skeletonSeconds = 0;     // CDT or segment Voronoi diagram and skeleton edges
+        double pathSearchSeconds = 0;   // search of the candidate paths
+        double evaluationSeconds = 0;   // fitting labels to the candidates
+
+        // Vertices of the input polygon, including the holes
+        size_t inputVertices = 0;
+        // Vertices of the subsampled polygon, including the holes
+        size_t sampledVertices = 0;
+        // Points added to the triangulation to make it conforming
+        size_t steinerPoints = 0;
+        size_t skeletonEdges = 0;
+        // Vertices and edges of the graph of the path search before and after
+        // the compaction (see Config::compactSkeleton), and the spurs pruned
+        size_t graphVertices = 0;
+        size_t graphEdges = 0;
+        size_t compactVertices = 0;
+        size_t compactEdges = 0;
+        size_t prunedSpurs = 0;
+        // Capacity levels visited by the path search
+        size_t capacityLevels = 0;
+        size_t candidatePaths = 0;
+        // Candidate paths skipped as their bound could not beat the best label
+        size_t prunedPaths = 0;
+        // Cups evaluated over all candidate paths
+        size_t cups = 0;
+
+        // true if the time budget ran out, see Config::timeBudget
+        bool partial = false;
+    };
+
+    /**
+     * Computes a curved label of the given aspect for the polygon.
+     * If stats is given it is filled with the measurements of the call.
+     *
+     * Thread safety: the function keeps no global state, concurrent calls on
+     * different (or the same, unmodified) polygons are safe.
+     */
+    std::optional<liblabel::AreaLabel> computeLabel( liblabel::Aspect,
+                                                     const liblabel::Polygon&,
+                                                     bool progress = false,
+                                                     liblabel::Config = liblabel::Config(),
+                                                     liblabel::LabelStats* stats = nullptr );
+
+    /**
+     * Working memory of computeLabel. Keeping a workspace per thread and
+     * passing it to every call lets the labeling reuse the buffers of the
+     * previous calls instead of allocating them again.
+     * A workspace must not be used by concurrent calls.
+     */
+    class LabelingWorkspace {
+    public:
+        LabelingWorkspace();
+        ~LabelingWorkspace();
+        LabelingWorkspace(LabelingWorkspace&&) noexcept;
+        LabelingWorkspace& operator=(LabelingWorkspace&&) noexcept;
+
+        struct Buffers;
+        Buffers& buffers() { return *impl; }
+
+    private:
+        std::unique_ptr<Buffers> impl;
+    };
+
+    std::optional<liblabel::AreaLabel> computeLabel( liblabel::Aspect,
+                                                     const liblabel::Polygon&,
+                                                     liblabel::LabelingWorkspace&,
+                                                     bool progress = false,
+                                                     liblabel::Config = liblabel::Config(),
+                                                     liblabel::LabelStats* stats = nullptr );
+
+    /**
+     * Computes a label for a polygon given as a view. Throws
+     * std::invalid_argument if the view has no rings or decreasing offsets.
+     */
+    std::optional<liblabel::AreaLabel> computeLabel( liblabel::Aspect,
+                                                     const liblabel::PolygonView&,
+                                                     bool progress = false,
+                                                     liblabel::Config = liblabel::Config(),
+                                                     liblabel::LabelStats* stats = nullptr );
+
+    std::optional<liblabel::AreaLabel> computeLabel( liblabel::Aspect,
+                                                     const liblabel::PolygonView&,
+                                                     liblabel::LabelingWorkspace&,
+                                                     bool progress = false,
+                                                     liblabel::Config = liblabel::Config(),
+                                                     liblabel::LabelStats* stats = nullptr );
+
+    /**
+     * Computes one label per aspect for the same polygon, e.g. for the names
+     * of an area in several languages. The polygon, its skeleton and the
+     * path graph are built only once and shared by all aspects; the i-th
+     * label is the one computeLabel returns for the i-th aspect.
+     * The stats sum up the path search and evaluation of all aspects.
+     */
+    std::vector<std::optional<liblabel::AreaLabel>> computeLabelsForAspects( const std::vector<liblabel::Aspect>&,
+                                                                             const liblabel::Polygon&,
+                                                                             bool progress = false,
+                                                                             liblabel::Config = liblabel::Config(),
+                                                                             liblabel::LabelStats* stats = nullptr );
+
+    std::vector<std::optional<liblabel::AreaLabel>> computeLabelsForAspects( const std::vector<liblabel::Aspect>&,
+                                                                             const liblabel::Polygon&,
+                                                                             liblabel::LabelingWorkspace&,
+                                                                             bool progress = false,
+                                                                             liblabel::Config = liblabel::Config(),
+                                                                             liblabel::LabelStats* stats = nullptr );
+
+    /**
+     * An edge of the skeleton graph as seen from one of its nodes
+     */
+    struct SkeletonArc {
+        // The node at the other end
+        uint32_t node;
+        // Index of the edge
+        uint32_t edge;
+    };
+
+    struct SkeletonEdgeData {
+        // Weight of the edge in the path search (its squared length)
+        double weight;
+        // Clearance of the edge, the path search keeps edges by it
+        double capacity;
     };
 
+    /**
+     * A non-owning view of the part of computeLabel that does not depend on
+     * the aspect: the subsampled boundary the labels are fitted against and
+     * the skeleton graph the candidate paths are searched in.
+     */
+    struct SkeletonGraphView {
+        // The rings after subsampling
+        PolygonView boundary;
+        // Largest clearance of a point inside of the polygon, or a bound of it
+        double maxClearance;
+
+        const Point* nodes;
+        size_t nodeCount;
+        // Compressed sparse rows: the arcs of node v are arcs[arcStarts[v]]
+        // to arcs[arcStarts[v + 1] - 1] by increasing edge index, so there
+        // are nodeCount + 1 entries. An edge has an arc at both of its
+        // nodes, a loop only one.
+        const uint64_t* arcStarts;
+        const SkeletonArc* arcs;
+        const SkeletonEdgeData* edges;
+        size_t edgeCount;
+    };
+
+    /**
+     * A skeleton graph owning its buffers, see SkeletonGraphView
+     */
+    struct SkeletonGraph {
+        std::vector<Point> boundary;
+        std::vector<size_t> ringOffsets;
+        double maxClearance = 0;
+
+        std::vector<Point> nodes;
+        std::vector<uint64_t> arcStarts;
+        std::vector<SkeletonArc> arcs;
+        std::vector<SkeletonEdgeData> edges;
+
+        // Valid until the graph is modified
+        SkeletonGraphView view() const;
+    };
+
+    /**
+     * Computes the subsampled boundary and the skeleton graph of the polygon
+     * into graph, reusing its memory. Returns false if no skeleton could be
+     * constructed, e.g. because the time budget ran out. Labels computed
+     * from the graph with the same config equal those of computeLabel.
+     */
+    bool computeSkeleton( const liblabel::Polygon&,
+                          liblabel::SkeletonGraph& graph,
+                          liblabel::LabelingWorkspace&,
+                          liblabel::Config = liblabel::Config(),
+                          liblabel::LabelStats* stats = nullptr );
+
+    /**
+     * Computes a label from a skeleton graph computed before, skipping the
+     * polygon and skeleton construction. Only the parameters of the config
+     * used after the skeleton construction apply. Throws
+     * std::invalid_argument if the graph refers to nodes or edges it does
+     * not have.
+     */
     std::optional<liblabel::AreaLabel> computeLabel( liblabel::Aspect,
-                                                     liblabel::Polygon&,
+                                                     const liblabel::SkeletonGraphView&,
+                                                     liblabel::LabelingWorkspace&,
                                                      bool progress = false,
-                                                     liblabel::Config = liblabel::Config() );
+                                                     liblabel::Config = liblabel::Config(),
+                                                     liblabel::LabelStats* stats = nullptr );
+
+    /**
+     * A single labeling task of a batch. The polygon is not owned by the job
+     * and has to outlive the call to computeLabels.
+     */
+    struct LabelJob {
+        Aspect aspect;
+        const Polygon* polygon;
+        Config config = Config();
+        // Labeled instead of the polygon if set. Jobs given as views are not
+        // looked up in or added to a cache.
+        const PolygonView* view = nullptr;
+    };
+
+    struct LabelResult {
+        // The computed label, empty if none could be constructed
+        std::optional<AreaLabel> label;
+        // Description of the failure if labeling the polygon threw
+        std::string error;
+        // Measurements of the job
+        LabelStats stats;
+    };
+
+    class LabelCache;
+
+    struct BatchConfig {
+        // Number of worker threads, 0 uses one thread per hardware core
+        size_t threads = 0;
+
+        // If set, labels are looked up in and added to the cache (see
+        // labelcache.h). Jobs answered by the cache report empty stats.
+        LabelCache* cache = nullptr;
+    };
+
+    /**
+     * Labels all jobs on a pool of worker threads. The i-th result belongs to
+     * the i-th job. A failing job does not affect the other jobs of the batch.
+     */
+    std::vector<liblabel::LabelResult> computeLabels( const liblabel::LabelJob* jobs,
+                                                      size_t count,
+                                                      liblabel::BatchConfig = liblabel::BatchConfig() );
+
+    std::vector<liblabel::LabelResult> computeLabels( const std::vector<liblabel::LabelJob>& jobs,
+                                                      liblabel::BatchConfig = liblabel::BatchConfig() );
 }
 
 #endif /* LIBLABELING_H */
\ No newline at end of file
@@ -0,0 +1,94 @@
+#ifndef LIBLABELING_C_H
+#define LIBLABELING_C_H
+
+/*
+ * Plain C interface of the labeling library for other runtimes. Polygons
+ * are passed as flat coordinate buffers like liblabel::PolygonView. No
+ * function throws; failures are reported by the returned status and
+ * liblabel_last_error.
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    LIBLABEL_OK = 0,
+    /* the polygon admits no label */
+    LIBLABEL_NO_LABEL = 1,
+    /* a null pointer, no rings or decreasing ring offsets */
+    LIBLABEL_INVALID_ARGUMENT = 2,
+    /* any other failure, see liblabel_last_error */
+    LIBLABEL_ERROR = 3
+} liblabel_status;
+
+/* See liblabel::Config, initialize with liblabel_default_config */
+typedef struct {
+    double step_size;
+    size_t number_of_paths;
+    size_t vertex_budget;
+    /* 0 uniform, 1 adaptive sampling */
+    int adaptive_sampling;
+    double simplify_tolerance;
+    size_t evaluation_threads;
+    int prune_candidates;
+    /* seconds, 0 is unlimited */
+    double time_budget;
+    /* 0 conforming CDT, 1 segment Voronoi skeleton */
+    int segment_voronoi_skeleton;
+    /* 0 exact predicates, 1 fast kernel for the path evaluation */
+    int fast_kernel;
+    /* 0 (default) searches the paths on the full skeleton graph */
+    int compact_skeleton;
+} liblabel_config;
+
+/* See liblabel::AreaLabel */
+typedef struct {
+    double center_x, center_y;
+    double rad_lower, rad_upper;
+    double from, to;
+    /* 1 if the time budget ran out before all candidates were evaluated */
+    int partial;
+} liblabel_label;
+
+/* Reusable working memory, one per thread */
+typedef struct liblabel_workspace liblabel_workspace;
+
+void liblabel_default_config(liblabel_config* config);
+
+liblabel_workspace* liblabel_workspace_create(void);
+void liblabel_workspace_destroy(liblabel_workspace* workspace);
+
+/*
+ * Computes a label of the given aspect. Point i of the polygon is
+ * (x[i * stride], y[i * stride]), ring r consists of the points
+ * ring_offsets[r] to ring_offsets[r + 1] - 1 where ring 0 is the outer
+ * boundary. ring_offsets holds ring_count + 1 non-decreasing offsets;
+ * they are all checked before any point is read, and x and y must hold
+ * the points up to ring_offsets[ring_count] - 1, which the library cannot
+ * check. config and workspace may be null for the defaults and a
+ * temporary workspace. The label is written on LIBLABEL_OK only.
+ */
+liblabel_status liblabel_compute_label(double aspect,
+                                       const double* x,
+                                       const double* y,
+                                       size_t stride,
+                                       const size_t* ring_offsets,
+                                       size_t ring_count,
+                                       const liblabel_config* config,
+                                       liblabel_workspace* workspace,
+                                       liblabel_label* label);
+
+/*
+ * Message of the last failure of the calling thread, empty if there was
+ * none. Valid until the next call on the same thread.
+ */
+const char* liblabel_last_error(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBLABELING_C_H */
@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <random>
+#include <unordered_map>
+
+#include "labelcache.h"
+
+namespace {
+    namespace fs = std::filesystem;
+
+    using Entry = std::optional<liblabel::AreaLabel>;
+
+    // Changing the layout of the key or of the files, or the labels computed
+    // for a key, requires a new version
+    const uint64_t FORMAT_VERSION = 9;
+    const char FILE_MAGIC[8] = {'l', 'b', 'l', 'c', 'a', 'c', 'h', 'e'};
+
+    // Feeds words into two independent 64 bit hashes, FNV-1a over the bytes
+    // and a splitmix64 chain over the words
+    class Hasher {
+    public:
+        void add(uint64_t word) {
+            for(int i = 0; i < 8; ++i) {
+                fnv = (fnv ^ ((word >> (8 * i)) & 0xff)) * 0x100000001b3ull;
+            }
+            mixed = mix(mixed ^ word);
+        }
+
+        void add(double value) {
+            if(value == 0) {
+                value = 0;      // -0.0 and 0.0 describe the same point
+            }
+            uint64_t word;
+            std::memcpy(&word, &value, sizeof(word));
+            add(word);
+        }
+
+        liblabel::CacheKey key() const { return {fnv, mix(mixed)}; }
+
+    private:
+        static uint64_t mix(uint64_t z) {
+            z += 0x9e3779b97f4a7c15ull;
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        uint64_t fnv = 0xcbf29ce484222325ull;
+        uint64_t mixed = 0;
+    };
+
+    void addRing(Hasher& hasher, const liblabel::Polyline& ring) {
+        hasher.add(uint64_t(ring.points.size()));
+        for(const auto& p : ring.points) {
+            hasher.add(p.x);
+            hasher.add(p.y);
+        }
+    }
+
+    struct KeyHash {
+        size_t operator()(const liblabel::CacheKey& key) const { return key.low; }
+    };
+
+    std::string toHex(const liblabel::CacheKey& key) {
+        static const char digits[] = "0123456789abcdef";
+        std::string hex;
+        for(uint64_t word : {key.high, key.low}) {
+            for(int i = 60; i >= 0; i -= 4) {
+                hex.push_back(digits[(word >> i) & 0xf]);
+            }
+        }
+        return hex;
+    }
+}
+
+liblabel::CacheKey liblabel::cacheKey(Aspect aspect, const Polygon& poly, const Config& config) {
+    Hasher hasher;
+    hasher.add(FORMAT_VERSION);
+
+    // Only parameters changing the label belong to the key, e.g.
+    // Config::evaluationThreads does not. Neither does Config::timeBudget,
+    // as labels cut short by it are never cached.
+    hasher.add(aspect);
+    hasher.add(config.stepSize);
+    hasher.add(uint64_t(config.numberOfPaths));
+    hasher.add(uint64_t(config.vertexBudget));
+    hasher.add(uint64_t(config.sampling));
+    hasher.add(config.simplifyTolerance);
+    hasher.add(uint64_t(config.skeleton));
+    hasher.add(uint64_t(config.kernel));
+    hasher.add(uint64_t(config.compactSkeleton));
+
+    // The rings are hashed as given: the subsampling, the simplification
+    // and the tie breaks of the path search depend on the start vertex and
+    // the order of the vertices and holes, so a rotated ring may get
+    // another label
+    addRing(hasher, poly.outer);
+    hasher.add(uint64_t(poly.holes.size()));
+    for(const auto& hole : poly.holes) {
+        addRing(hasher, hole);
+    }
+
+    return hasher.key();
+}
+
+struct liblabel::LabelCache::Impl {
+    CacheConfig config;
+
+    // Most recently used entries first
+    std::mutex mutex;
+    std::list<std::pair<CacheKey, Entry>> lru;
+    std::unordered_map<CacheKey, decltype(lru)::iterator, KeyHash> index;
+
+    std::atomic<size_t> memoryHits{0}, diskHits{0}, misses{0};
+
+    // Makes the names of temporary files unique among threads and processes
+    std::atomic<uint64_t> writes{0};
+    uint64_t nonce = std::random_device()();
+
+    std::optional<Entry> findInMemory(const CacheKey& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if(it == index.end()) {
+            return {};
+        }
+        lru.splice(lru.begin(), lru, it->second);
+        return it->second->second;
+    }
+
+    void storeInMemory(const CacheKey& key, const Entry& entry) {
+        if(config.capacity == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if(it != index.end()) {
+            it->second->second = entry;
+            lru.splice(lru.begin(), lru, it->second);
+            return;
+        }
+        lru.emplace_front(key, entry);
+        index[key] = lru.begin();
+        if(lru.size() > config.capacity) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+    }
+
+    // Entries are spread over 256 sub folders named by the first byte of the key
+    fs::path filePath(const CacheKey& key) const {
+        std::string hex = toHex(key);
+        return fs::path(config.directory) / hex.substr(0, 2) / (hex + ".label");
+    }
+
+    // Unreadable or truncated files count as misses
+    std::optional<Entry> readFile(const CacheKey& key) const {
+        if(config.directory.empty()) {
+            return {};
+        }
+        std::ifstream in(filePath(key), std::ios::binary);
+        if(!in) {
+            return {};
+        }
+
+        char magic[sizeof(FILE_MAGIC)];
+        char hasLabel;
+        double values[6];
+        in.read(magic, sizeof(magic));
+        in.read(&hasLabel, 1);
+        in.read(reinterpret_cast<char*>(values), sizeof(values));
+        if(!in || std::memcmp(magic, FILE_MAGIC, sizeof(magic)) != 0) {
+            return {};
+        }
+
+        if(!hasLabel) {
+            return Entry();
+        }
+        return Entry(AreaLabel{{values[0], values[1]}, values[2], values[3], values[4], values[5]});
+    }
+
+    // Files are written to a temporary name and renamed, so readers never
+    // see a partially written entry. Failing writes only lose the entry.
+    void writeFile(const CacheKey& key, const Entry& entry) {
+        if(config.directory.empty()) {
+            return;
+        }
+        fs::path path = filePath(key);
+        fs::path tmp = path;
+        tmp += ".tmp" + std::to_string(nonce) + "_" + std::to_string(writes++);
+
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        {
+            std::ofstream out(tmp, std::ios::binary);
+            char hasLabel = entry.has_value();
+            double values[6] = {};
+            if(entry.has_value()) {
+                const AreaLabel& l = *entry;
+                double v[6] = {l.center.x, l.center.y, l.rad_lower, l.rad_upper, l.from, l.to};
+                std::copy(v, v + 6, values);
+            }
+            out.write(FILE_MAGIC, sizeof(FILE_MAGIC));
+            out.write(&hasLabel, 1);
+            out.write(reinterpret_cast<const char*>(values), sizeof(values));
+            if(!out) {
+                out.close();
+                fs::remove(tmp, ec);
+                return;
+            }
+        }
+        fs::rename(tmp, path, ec);
+        if(ec) {
+            fs::remove(tmp, ec);
+        }
+    }
+};
+
+liblabel::LabelCache::LabelCache(CacheConfig config) : impl(std::make_unique<Impl>()) {
+    impl->config = std::move(config);
+    if(!impl->config.directory.empty()) {
+        fs::create_directories(impl->config.directory);
+    }
+}
+
+liblabel::LabelCache::~LabelCache() = default;
+
+std::optional<std::optional<liblabel::AreaLabel>> liblabel::LabelCache::find(const CacheKey& key) {
+    if(auto entry = impl->findInMemory(key)) {
+        ++impl->memoryHits;
+        return entry;
+    }
+    if(auto entry = impl->readFile(key)) {
+        ++impl->diskHits;
+        impl->storeInMemory(key, *entry);
+        return entry;
+    }
+    ++impl->misses;
+    return {};
+}
+
+void liblabel::LabelCache::insert(const CacheKey& key, const std::optional<AreaLabel>& label) {
+    impl->storeInMemory(key, label);
+    impl->writeFile(key, label);
+}
+
+std::optional<liblabel::AreaLabel> liblabel::LabelCache::computeLabel(
+        liblabel::Aspect aspect,
+        const Polygon& poly,
+        liblabel::Config configuration
+    ){
+    CacheKey key = cacheKey(aspect, poly, configuration);
+    if(auto entry = find(key)) {
+        return *entry;
+    }
+
+    LabelStats stats;
+    auto label = liblabel::computeLabel(aspect, poly, false, configuration, &stats);
+    if(!stats.partial) {
+        insert(key, label);
+    }
+    return label;
+}
+
+std::optional<liblabel::AreaLabel> liblabel::LabelCache::computeLabel(
+        liblabel::Aspect aspect,
+        const Polygon& poly,
+        LabelingWorkspace& workspace,
+        liblabel::Config configuration
+    ){
+    CacheKey key = cacheKey(aspect, poly, configuration);
+    if(auto entry = find(key)) {
+        return *entry;
+    }
+
+    LabelStats stats;
+    auto label = liblabel::computeLabel(aspect, poly, workspace, false, configuration, &stats);
+    if(!stats.partial) {
+        insert(key, label);
+    }
+    return label;
+}
+
+liblabel::CacheStats liblabel::LabelCache::stats() const {
+    return {impl->memoryHits, impl->diskHits, impl->misses};
+}
@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "labelcorpus.h"
+
+namespace {
+    // Changing the layout of the file requires a new version
+    const uint32_t FORMAT_VERSION = 1;
+    const char FILE_MAGIC[8] = {'l', 'b', 'l', 'c', 'o', 'r', 'p', 's'};
+    // Written in host order, a reader on a big endian host sees it swapped
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+    const uint32_t FLAG_QUANTIZED = 1;
+
+    struct Header {
+        char magic[8];
+        uint32_t version, byteOrder, flags, reserved;
+        uint64_t records, rings, points, idBytes;
+        uint64_t coordinatesOffset, ringsOffset, recordsOffset, idsOffset;
+    };
+
+    struct RecordEntry {
+        double aspect, originX, originY, scale;
+        uint64_t firstRing, ringCount, idOffset, idLength;
+    };
+
+    static_assert(sizeof(Header) == 88 && sizeof(RecordEntry) == 64, "corpus layout changed");
+
+    // Whether [offset, offset + count * size) lies within length bytes
+    bool fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t length) {
+        return offset <= length && offset % 8 == 0 && count <= (length - offset) / size;
+    }
+
+    const RecordEntry& entry(const void* records, size_t index) {
+        return static_cast<const RecordEntry*>(records)[index];
+    }
+}
+
+std::string_view liblabel::CorpusRecordView::id() const {
+    const RecordEntry& e = entry(reader->records, index);
+    return {reader->ids + e.idOffset, e.idLength};
+}
+
+liblabel::Aspect liblabel::CorpusRecordView::aspect() const {
+    return entry(reader->records, index).aspect;
+}
+
+size_t liblabel::CorpusRecordView::rings() const {
+    return entry(reader->records, index).ringCount;
+}
+
+size_t liblabel::CorpusRecordView::ringSize(size_t ring) const {
+    size_t r = entry(reader->records, index).firstRing + ring;
+    return reader->ringStarts[r + 1] - reader->ringStarts[r];
+}
+
+liblabel::Point liblabel::CorpusRecordView::point(size_t ring, size_t i) const {
+    const RecordEntry& e = entry(reader->records, index);
+    size_t p = reader->ringStarts[e.firstRing + ring] + i;
+    if(reader->isQuantized) {
+        const int32_t* q = static_cast<const int32_t*>(reader->coordinates) + 2 * p;
+        return {e.originX + q[0] * e.scale, e.originY + q[1] * e.scale};
+    }
+    const double* c = static_cast<const double*>(reader->coordinates) + 2 * p;
+    return {c[0], c[1]};
+}
+
+void liblabel::CorpusRecordView::toPolygon(Polygon& poly) const {
+    size_t count = rings();
+    poly.holes.resize(count > 0 ? count - 1 : 0);
+    if(count == 0) {
+        poly.outer.points.clear();
+    }
+    for(size_t r = 0; r < count; ++r) {
+        auto& points = r == 0 ? poly.outer.points : poly.holes[r - 1].points;
+        points.resize(ringSize(r));
+        for(size_t i = 0; i < points.size(); ++i) {
+            points[i] = point(r, i);
+        }
+    }
+}
+
+std::optional<liblabel::PolygonView> liblabel::CorpusRecordView::polygonView() const {
+    if(reader->isQuantized || sizeof(size_t) != sizeof(uint64_t)) {
+        return {};
+    }
+    const RecordEntry& e = entry(reader->records, index);
+    const double* coords = static_cast<const double*>(reader->coordinates);
+    // The ring table holds global point indices, which are the offsets of
+    // the view as it starts at the first coordinate of the file
+    return PolygonView{coords, coords + 1, 2, reinterpret_cast<const size_t*>(reader->ringStarts + e.firstRing), e.ringCount};
+}
+
+liblabel::CorpusReader::CorpusReader(const std::string& path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("Could not open the corpus " + path);
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("Not a corpus file: " + path);
+    }
+    length = st.st_size;
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mapped == MAP_FAILED) {
+        throw std::runtime_error("Could not map the corpus " + path);
+    }
+    data = static_cast<const unsigned char*>(mapped);
+
+    auto invalid = [&](const std::string& reason) {
+        ::munmap(const_cast<unsigned char*>(data), length);
+        return std::runtime_error("Invalid corpus " + path + ": " + reason);
+    };
+
+    Header h;
+    std::memcpy(&h, data, sizeof(h));
+    if(std::memcmp(h.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        throw invalid("bad magic");
+    }
+    if(h.version != FORMAT_VERSION) {
+        throw invalid("unsupported version " + std::to_string(h.version));
+    }
+    if(h.byteOrder != BYTE_ORDER_MARK) {
+        throw invalid("written with a different byte order");
+    }
+    isQuantized = h.flags & FLAG_QUANTIZED;
+    size_t pointSize = isQuantized ? 2 * sizeof(int32_t) : 2 * sizeof(double);
+    if(!fits(h.coordinatesOffset, h.points, pointSize, length)
+       || h.rings == std::numeric_limits<uint64_t>::max()
+       || !fits(h.ringsOffset, h.rings + 1, sizeof(uint64_t), length)
+       || !fits(h.recordsOffset, h.records, sizeof(RecordEntry), length)
+       || !fits(h.idsOffset, h.idBytes, 1, length)) {
+        throw invalid("truncated");
+    }
+    recordCount = h.records;
+    coordinates = data + h.coordinatesOffset;
+    ringStarts = reinterpret_cast<const uint64_t*>(data + h.ringsOffset);
+    records = data + h.recordsOffset;
+    ids = reinterpret_cast<const char*>(data + h.idsOffset);
+
+    // Checking the tables once keeps the accessors free of bounds checks
+    if(ringStarts[0] != 0 || ringStarts[h.rings] != h.points) {
+        throw invalid("inconsistent ring table");
+    }
+    for(uint64_t r = 0; r < h.rings; ++r) {
+        if(ringStarts[r] > ringStarts[r + 1]) {
+            throw invalid("inconsistent ring table");
+        }
+    }
+    for(size_t i = 0; i < recordCount; ++i) {
+        const RecordEntry& e = entry(records, i);
+        if(e.firstRing > h.rings || e.ringCount > h.rings - e.firstRing
+           || e.idOffset > h.idBytes || e.idLength > h.idBytes - e.idOffset) {
+            throw invalid("inconsistent record " + std::to_string(i));
+        }
+    }
+}
+
+liblabel::CorpusReader::~CorpusReader() {
+    ::munmap(const_cast<unsigned char*>(data), length);
+}
+
+liblabel::CorpusRecordView liblabel::CorpusReader::operator[](size_t record) const {
+    CorpusRecordView view;
+    view.reader = this;
+    view.index = record;
+    return view;
+}
+
+liblabel::CorpusWriter::CorpusWriter(const std::string& path, bool quantize)
+        : out(path, std::ios::binary | std::ios::trunc), quantize(quantize) {
+    if(!out) {
+        throw std::runtime_error("Could not create the corpus " + path);
+    }
+    // The header is written by finish, the coordinates follow it
+    Header h{};
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+}
+
+liblabel::CorpusWriter::~CorpusWriter() {
+    if(!finished) {
+        try {
+            finish();
+        } catch(...) {
+        }
+    }
+}
+
+void liblabel::CorpusWriter::writeRing(const Polyline& ring, double originX, double originY, double scale) {
+    ringStarts.push_back(points);
+    points += ring.points.size();
+    if(!quantize) {
+        static_assert(sizeof(Point) == 2 * sizeof(double), "points are written as they are");
+        out.write(reinterpret_cast<const char*>(ring.points.data()), ring.points.size() * sizeof(Point));
+        return;
+    }
+
+    const double maxValue = std::numeric_limits<int32_t>::max();
+    std::vector<int32_t> quantized;
+    quantized.reserve(2 * ring.points.size());
+    for(const auto& p : ring.points) {
+        quantized.push_back(std::clamp(std::round((p.x - originX) / scale), 0., maxValue));
+        quantized.push_back(std::clamp(std::round((p.y - originY) / scale), 0., maxValue));
+    }
+    out.write(reinterpret_cast<const char*>(quantized.data()), quantized.size() * sizeof(int32_t));
+}
+
+void liblabel::CorpusWriter::add(std::string_view id, Aspect aspect, const Polygon& poly) {
+    if(finished) {
+        throw std::logic_error("The corpus is already finished");
+    }
+
+    RecordEntry e{aspect, 0, 0, 1, ringStarts.size(), 1 + poly.holes.size(), ids.size(), id.size()};
+    if(quantize) {
+        // Holes of invalid input may leave the outer boundary, so the box
+        // covers every ring
+        double minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+        auto extend = [&](const Polyline& ring) {
+            for(const auto& p : ring.points) {
+                minX = std::min(minX, p.x);
+                minY = std::min(minY, p.y);
+                maxX = std::max(maxX, p.x);
+                maxY = std::max(maxY, p.y);
+            }
+        };
+        extend(poly.outer);
+        for(const auto& hole : poly.holes) {
+            extend(hole);
+        }
+        if(minX > maxX) {
+            // No points at all
+            minX = maxX = minY = maxY = 0;
+        }
+        if(!std::isfinite(maxX - minX) || !std::isfinite(maxY - minY)) {
+            throw std::invalid_argument("Cannot quantize non-finite coordinates of " + std::string(id));
+        }
+        e.originX = minX;
+        e.originY = minY;
+        e.scale = std::max(maxX - minX, maxY - minY) / std::numeric_limits<int32_t>::max();
+        if(!(e.scale > 0)) {
+            e.scale = 1;
+        }
+    }
+
+    writeRing(poly.outer, e.originX, e.originY, e.scale);
+    for(const auto& hole : poly.holes) {
+        writeRing(hole, e.originX, e.originY, e.scale);
+    }
+    entries.append(reinterpret_cast<const char*>(&e), sizeof(e));
+    ids.append(id);
+    if(!out) {
+        throw std::runtime_error("Could not write the corpus");
+    }
+}
+
+void liblabel::CorpusWriter::finish() {
+    if(finished) {
+        return;
+    }
+    finished = true;
+
+    Header h{};
+    std::memcpy(h.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    h.version = FORMAT_VERSION;
+    h.byteOrder = BYTE_ORDER_MARK;
+    h.flags = quantize ? FLAG_QUANTIZED : 0;
+    h.records = entries.size() / sizeof(RecordEntry);
+    h.rings = ringStarts.size();
+    h.points = points;
+    h.idBytes = ids.size();
+
+    // Every point takes a multiple of 8 bytes, so all sections stay aligned
+    h.coordinatesOffset = sizeof(Header);
+    h.ringsOffset = h.coordinatesOffset + points * (quantize ? 2 * sizeof(int32_t) : sizeof(Point));
+    ringStarts.push_back(points);
+    h.recordsOffset = h.ringsOffset + ringStarts.size() * sizeof(uint64_t);
+    h.idsOffset = h.recordsOffset + entries.size();
+
+    out.write(reinterpret_cast<const char*>(ringStarts.data()), ringStarts.size() * sizeof(uint64_t));
+    out.write(entries.data(), entries.size());
+    out.write(ids.data(), ids.size());
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    out.close();
+    if(!out) {
+        throw std::runtime_error("Could not write the corpus");
+    }
+}
@@ -0,0 +1,639 @@
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+#include "labelgeojson.h"
+
+namespace {
+    // The aspect of a single character as used by the web gui
+    const double CHARACTER_ASPECT = 1.63;
+    // Height of the text baseline above the lower arc of the label relative
+    // to the label height, as drawn by the web gui
+    const double BASELINE = 0.1;
+
+    bool isWhitespace(int c) {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+    }
+
+    void appendUtf8(std::string& out, uint32_t cp) {
+        if(cp < 0x80) {
+            out += char(cp);
+        } else if(cp < 0x800) {
+            out += char(0xc0 | (cp >> 6));
+            out += char(0x80 | (cp & 0x3f));
+        } else if(cp < 0x10000) {
+            out += char(0xe0 | (cp >> 12));
+            out += char(0x80 | ((cp >> 6) & 0x3f));
+            out += char(0x80 | (cp & 0x3f));
+        } else {
+            out += char(0xf0 | (cp >> 18));
+            out += char(0x80 | ((cp >> 12) & 0x3f));
+            out += char(0x80 | ((cp >> 6) & 0x3f));
+            out += char(0x80 | (cp & 0x3f));
+        }
+    }
+
+    void appendJsonString(std::string& out, const std::string& s) {
+        static const char digits[] = "0123456789abcdef";
+        out += '"';
+        for(char c : s) {
+            switch(c) {
+            case '"': out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if(static_cast<unsigned char>(c) < 0x20) {
+                    out += "\\u00";
+                    out += digits[c >> 4];
+                    out += digits[c & 0xf];
+                } else {
+                    out += c;
+                }
+            }
+        }
+        out += '"';
+    }
+
+    void appendNumber(std::string& out, double value) {
+        char buffer[32];
+        auto res = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        out.append(buffer, res.ptr);
+    }
+
+    // A small JSON document model, only used for the properties of a feature
+    struct Value {
+        enum class Type { Null, Bool, Number, String, Array, Object };
+        Type type = Type::Null;
+        // The text of literals and numbers as read, the decoded strings
+        std::string text;
+        std::vector<Value> items;
+        std::vector<std::pair<std::string, Value>> members;
+
+        Value* member(const std::string& key) {
+            for(auto& m : members) {
+                if(m.first == key) {
+                    return &m.second;
+                }
+            }
+            return nullptr;
+        }
+
+        Value& setMember(const std::string& key, Value value) {
+            if(Value* m = member(key)) {
+                return *m = std::move(value);
+            }
+            members.emplace_back(key, std::move(value));
+            return members.back().second;
+        }
+
+        void write(std::string& out) const {
+            switch(type) {
+            case Type::Null: out += "null"; break;
+            case Type::Bool:
+            case Type::Number: out += text; break;
+            case Type::String: appendJsonString(out, text); break;
+            case Type::Array:
+                out += '[';
+                for(size_t i = 0; i < items.size(); ++i) {
+                    if(i > 0) out += ", ";
+                    items[i].write(out);
+                }
+                out += ']';
+                break;
+            case Type::Object:
+                out += '{';
+                for(size_t i = 0; i < members.size(); ++i) {
+                    if(i > 0) out += ", ";
+                    appendJsonString(out, members[i].first);
+                    out += ": ";
+                    members[i].second.write(out);
+                }
+                out += '}';
+                break;
+            }
+        }
+    };
+
+    Value numberValue(double value) {
+        Value v;
+        v.type = Value::Type::Number;
+        appendNumber(v.text, value);
+        return v;
+    }
+
+    // Recursive descent parser over the text of a single feature
+    class Parser {
+    public:
+        explicit Parser(std::string_view text) : s(text) {}
+
+        size_t position() const { return pos; }
+
+        void whitespace() {
+            while(pos < s.size() && isWhitespace(s[pos])) ++pos;
+        }
+
+        char peek() {
+            whitespace();
+            return pos < s.size() ? s[pos] : '\0';
+        }
+
+        void expect(char c) {
+            if(peek() != c) {
+                fail(std::string("expected '") + c + "'");
+            }
+            ++pos;
+        }
+
+        // Consumes c if it is the next character
+        bool accept(char c) {
+            if(peek() == c) {
+                ++pos;
+                return true;
+            }
+            return false;
+        }
+
+        [[noreturn]] void fail(const std::string& what) {
+            throw std::runtime_error(what + " at offset " + std::to_string(pos));
+        }
+
+        std::string string() {
+            expect('"');
+            std::string res;
+            while(pos < s.size() && s[pos] != '"') {
+                char c = s[pos++];
+                if(c != '\\') {
+                    res += c;
+                    continue;
+                }
+                if(pos >= s.size()) break;
+                switch(char e = s[pos++]) {
+                case 'b': res += '\b'; break;
+                case 'f': res += '\f'; break;
+                case 'n': res += '\n'; break;
+                case 'r': res += '\r'; break;
+                case 't': res += '\t'; break;
+                case 'u': {
+                    uint32_t cp = hex4();
+                    if(cp >= 0xd800 && cp < 0xdc00 && s.substr(pos, 2) == "\\u") {
+                        pos += 2;
+                        cp = 0x10000 + ((cp - 0xd800) << 10) + (hex4() - 0xdc00);
+                    }
+                    appendUtf8(res, cp);
+                    break;
+                }
+                default: res += e;
+                }
+            }
+            expect('"');
+            return res;
+        }
+
+        double number() {
+            whitespace();
+            double value;
+            auto res = std::from_chars(s.data() + pos, s.data() + s.size(), value);
+            if(res.ec != std::errc()) {
+                fail("expected a number");
+            }
+            pos = res.ptr - s.data();
+            return value;
+        }
+
+        void skipValue() {
+            value();
+        }
+
+        Value value() {
+            Value v;
+            switch(peek()) {
+            case '{':
+                v.type = Value::Type::Object;
+                ++pos;
+                if(accept('}')) break;
+                do {
+                    std::string key = string();
+                    expect(':');
+                    v.members.emplace_back(std::move(key), value());
+                } while(accept(','));
+                expect('}');
+                break;
+            case '[':
+                v.type = Value::Type::Array;
+                ++pos;
+                if(accept(']')) break;
+                do {
+                    v.items.push_back(value());
+                } while(accept(','));
+                expect(']');
+                break;
+            case '"':
+                v.type = Value::Type::String;
+                v.text = string();
+                break;
+            case 't':
+            case 'f':
+            case 'n': {
+                size_t start = pos;
+                while(pos < s.size() && std::isalpha(static_cast<unsigned char>(s[pos]))) ++pos;
+                v.text = s.substr(start, pos - start);
+                if(v.text == "null") {
+                    v.type = Value::Type::Null;
+                } else if(v.text == "true" || v.text == "false") {
+                    v.type = Value::Type::Bool;
+                } else {
+                    fail("unknown literal");
+                }
+                break;
+            }
+            default: {
+                size_t start = pos;
+                number();
+                v.type = Value::Type::Number;
+                v.text = s.substr(start, pos - start);
+            }
+            }
+            return v;
+        }
+
+        // Number of nested arrays the next value starts with
+        size_t arrayDepth() {
+            whitespace();
+            size_t depth = 0;
+            for(size_t p = pos; p < s.size() && (s[p] == '[' || isWhitespace(s[p])); ++p) {
+                depth += s[p] == '[';
+            }
+            return depth;
+        }
+
+        // [[x, y, ...], ...], further dimensions are ignored
+        void ring(liblabel::Polyline& pl) {
+            pl.points.clear();
+            expect('[');
+            if(!accept(']')) {
+                do {
+                    expect('[');
+                    double x = number();
+                    expect(',');
+                    double y = number();
+                    while(accept(',')) {
+                        number();
+                    }
+                    expect(']');
+                    pl.points.push_back({x, y});
+                } while(accept(','));
+                expect(']');
+            }
+            const auto& pts = pl.points;
+            if(pts.size() > 1 && pts.front().x == pts.back().x && pts.front().y == pts.back().y) {
+                pl.points.pop_back();
+            }
+        }
+
+        // The rings of a polygon, the first one is the outer boundary
+        void polygon(liblabel::Polygon& poly) {
+            expect('[');
+            if(accept(']')) return;
+            ring(poly.outer);
+            while(accept(',')) {
+                poly.holes.emplace_back();
+                ring(poly.holes.back());
+            }
+            expect(']');
+        }
+
+        void geometry(std::vector<liblabel::Polygon>& polygons) {
+            if(peek() != '{') {
+                skipValue();
+                return;
+            }
+            ++pos;
+            std::string type;
+            size_t depth = 0;
+            if(!accept('}')) {
+                do {
+                    std::string key = string();
+                    expect(':');
+                    if(key == "type") {
+                        type = string();
+                    } else if(key == "coordinates" && (depth = arrayDepth()) == 3) {
+                        polygons.emplace_back();
+                        polygon(polygons.back());
+                    } else if(key == "coordinates" && depth == 4) {
+                        expect('[');
+                        do {
+                            polygons.emplace_back();
+                            polygon(polygons.back());
+                        } while(accept(','));
+                        expect(']');
+                    } else {
+                        skipValue();
+                    }
+                } while(accept(','));
+                expect('}');
+            }
+            if(!((type == "Polygon" && depth == 3) || (type == "MultiPolygon" && depth == 4))) {
+                polygons.clear();
+            }
+        }
+
+    private:
+        uint32_t hex4() {
+            if(pos + 4 > s.size()) fail("truncated escape");
+            uint32_t cp = 0;
+            auto res = std::from_chars(s.data() + pos, s.data() + pos + 4, cp, 16);
+            if(res.ptr != s.data() + pos + 4) fail("invalid escape");
+            pos += 4;
+            return cp;
+        }
+
+        std::string_view s;
+        size_t pos = 0;
+    };
+
+    // The label text of the properties, see GeoJsonFeature::text
+    std::string labelText(Value& properties) {
+        Value* label = properties.member("label");
+        if(label && label->type == Value::Type::Object) {
+            label = label->member("label");
+        }
+        if(label && label->type == Value::Type::String) {
+            return label->text;
+        }
+        if(label && label->type == Value::Type::Array) {
+            std::string text;
+            for(const auto& item : label->items) {
+                if(item.type == Value::Type::String) {
+                    text += (text.empty() ? "" : " ") + item.text;
+                }
+            }
+            return text;
+        }
+        Value* name = properties.member("name");
+        return name && name->type == Value::Type::String ? name->text : "";
+    }
+
+    double area(const liblabel::Polyline& pl) {
+        double a = 0;
+        for(size_t i = 0; i < pl.points.size(); ++i) {
+            const auto& p = pl.points[i];
+            const auto& q = pl.points[(i + 1) % pl.points.size()];
+            a += p.x * q.y - q.x * p.y;
+        }
+        return std::abs(a) / 2;
+    }
+
+    // The value of a member given by the text range of "key": value
+    std::string_view memberValue(std::string_view member) {
+        Parser p(member);
+        p.string();
+        p.expect(':');
+        p.whitespace();
+        return member.substr(p.position());
+    }
+}
+
+liblabel::Aspect liblabel::textAspect(std::string_view text) {
+    size_t characters = 0;
+    for(char c : text) {
+        characters += (static_cast<unsigned char>(c) & 0xc0) != 0x80;
+    }
+    return CHARACTER_ASPECT / characters;
+}
+
+const liblabel::Polygon* liblabel::GeoJsonFeature::largestPolygon() const {
+    const Polygon* best = nullptr;
+    double bestArea = -1;
+    for(const auto& poly : polygons) {
+        double a = area(poly.outer);
+        for(const auto& hole : poly.holes) {
+            a -= area(hole);
+        }
+        if(a > bestArea) {
+            best = &poly;
+            bestArea = a;
+        }
+    }
+    return best;
+}
+
+liblabel::GeoJsonReader::GeoJsonReader(std::istream& in) : buffer(in.rdbuf()) {}
+
+int liblabel::GeoJsonReader::peek() {
+    return buffer->sgetc();
+}
+
+int liblabel::GeoJsonReader::get() {
+    return buffer->sbumpc();
+}
+
+void liblabel::GeoJsonReader::skipWhitespace() {
+    while(isWhitespace(peek())) get();
+}
+
+void liblabel::GeoJsonReader::expect(char c) {
+    skipWhitespace();
+    if(get() != c) {
+        throw std::runtime_error(std::string("GeoJSON: expected '") + c + "'");
+    }
+}
+
+void liblabel::GeoJsonReader::captureValue(std::string& out) {
+    const int eof = std::char_traits<char>::eof();
+    skipWhitespace();
+    int first = peek();
+    if(first != '"' && first != '{' && first != '[') {
+        // A number or a literal
+        for(int c = peek(); c != eof && c != ',' && c != '}' && c != ']' && !isWhitespace(c); c = peek()) {
+            out += char(get());
+        }
+        return;
+    }
+
+    size_t depth = 0;
+    bool inString = false;
+    for(;;) {
+        int c = get();
+        if(c == eof) {
+            throw std::runtime_error("GeoJSON: unexpected end of the document");
+        }
+        out += char(c);
+        if(inString) {
+            if(c == '\\') {
+                out += char(get());
+            } else if(c == '"') {
+                inString = false;
+                if(depth == 0) return;
+            }
+        } else if(c == '"') {
+            inString = true;
+        } else if(c == '{' || c == '[') {
+            ++depth;
+        } else if((c == '}' || c == ']') && --depth == 0) {
+            return;
+        }
+    }
+}
+
+bool liblabel::GeoJsonReader::next(GeoJsonFeature& feature) {
+    feature.json.clear();
+    if(state == State::Start) {
+        skipWhitespace();
+        int c = get();
+        if(c == '[') {
+            state = State::Features;
+        } else if(c == '{') {
+            // Either a FeatureCollection or a single feature, which is only
+            // known once a features member shows up or the object ended
+            topLevelObject = true;
+            skipWhitespace();
+            while(peek() != '}') {
+                std::string key;
+                captureValue(key);
+                expect(':');
+                if(key == "\"features\"") {
+                    expect('[');
+                    state = State::Features;
+                    break;
+                }
+                pendingMembers += (pendingMembers.empty() ? "" : ", ") + key + ": ";
+                captureValue(pendingMembers);
+                skipWhitespace();
+                if(peek() == ',') get();
+                skipWhitespace();
+            }
+            if(state != State::Features) {
+                get();
+                state = State::Done;
+                if(pendingMembers.empty()) {
+                    return false;
+                }
+                feature.json = "{" + pendingMembers + "}";
+                parse(feature);
+                return true;
+            }
+        } else {
+            throw std::runtime_error("GeoJSON: expected a FeatureCollection, a feature or an array of features");
+        }
+    }
+    if(state == State::Done) {
+        return false;
+    }
+
+    skipWhitespace();
+    if(peek() == ',') {
+        get();
+        skipWhitespace();
+    }
+    if(peek() == ']') {
+        get();
+        state = State::Done;
+        return false;
+    }
+    captureValue(feature.json);
+    parse(feature);
+    return true;
+}
+
+void liblabel::GeoJsonReader::parse(GeoJsonFeature& feature) {
+    feature.polygons.clear();
+    feature.text.clear();
+    feature.error.clear();
+    feature.members.clear();
+    feature.properties = 0;
+
+    Parser p(feature.json);
+    try {
+        p.expect('{');
+        bool hasProperties = false;
+        if(!p.accept('}')) {
+            do {
+                p.whitespace();
+                size_t start = p.position();
+                std::string key = p.string();
+                p.expect(':');
+                if(key == "geometry") {
+                    p.geometry(feature.polygons);
+                } else if(key == "properties") {
+                    Value properties = p.value();
+                    if(properties.type == Value::Type::Object) {
+                        feature.text = labelText(properties);
+                    }
+                    feature.properties = feature.members.size();
+                    hasProperties = true;
+                } else {
+                    p.skipValue();
+                }
+                feature.members.emplace_back(start, p.position());
+            } while(p.accept(','));
+            p.expect('}');
+        }
+        if(!hasProperties) {
+            feature.properties = feature.members.size();
+        }
+    } catch(const std::exception& e) {
+        feature.polygons.clear();
+        feature.members.clear();
+        feature.error = e.what();
+    }
+}
+
+std::string liblabel::labeledFeature(const GeoJsonFeature& feature, const std::optional<AreaLabel>& label) {
+    if(!label.has_value() || !feature.error.empty()) {
+        return feature.json;
+    }
+    std::string_view json = feature.json;
+
+    Value properties;
+    if(feature.properties < feature.members.size()) {
+        auto [start, end] = feature.members[feature.properties];
+        properties = Parser(memberValue(json.substr(start, end - start))).value();
+    }
+    if(properties.type != Value::Type::Object) {
+        properties = Value();
+        properties.type = Value::Type::Object;
+    }
+    Value* labelProperty = properties.member("label");
+    if(!labelProperty || labelProperty->type != Value::Type::Object) {
+        Value object;
+        object.type = Value::Type::Object;
+        if(labelProperty) {
+            object.setMember("label", std::move(*labelProperty));
+        }
+        labelProperty = &properties.setMember("label", std::move(object));
+    }
+
+    Value baseline;
+    baseline.type = Value::Type::Object;
+    Value center;
+    center.type = Value::Type::Array;
+    center.items = {numberValue(label->center.x), numberValue(label->center.y)};
+    baseline.setMember("center", std::move(center));
+    baseline.setMember("radius", numberValue(label->rad_lower + BASELINE * (label->rad_upper - label->rad_lower)));
+    baseline.setMember("from", numberValue(label->from));
+    baseline.setMember("to", numberValue(label->to));
+    baseline.setMember("rad_lower", numberValue(label->rad_lower));
+    baseline.setMember("rad_upper", numberValue(label->rad_upper));
+    labelProperty->setMember("baseline", std::move(baseline));
+
+    std::string res = "{";
+    for(size_t i = 0; i < feature.members.size(); ++i) {
+        if(i > 0) res += ", ";
+        if(i == feature.properties) {
+            res += "\"properties\": ";
+            properties.write(res);
+        } else {
+            auto [start, end] = feature.members[i];
+            res.append(json.substr(start, end - start));
+        }
+    }
+    if(feature.properties == feature.members.size()) {
+        res += feature.members.empty() ? "\"properties\": " : ", \"properties\": ";
+        properties.write(res);
+    }
+    res += "}";
+    return res;
+}
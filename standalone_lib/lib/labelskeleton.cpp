@@ -0,0 +1,337 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "labelskeleton.h"
+
+namespace {
+    // Changing the layout of the file, or the skeletons computed for the
+    // same parameters, requires a new version. Version 2: the sampling
+    // budget covers the outer ring only and segment Voronoi skeletons keep
+    // all corners at shared vertices.
+    const uint32_t FORMAT_VERSION = 2;
+    const char FILE_MAGIC[8] = {'l', 'b', 'l', 's', 'k', 'e', 'l', 't'};
+    // Written in host order, a reader on a big endian host sees it swapped
+    const uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    struct Header {
+        char magic[8];
+        uint32_t version, byteOrder;
+        // The parameters of the polygon and skeleton construction
+        uint64_t vertexBudget;
+        uint32_t sampling, skeleton;
+        double simplifyTolerance;
+        uint64_t records, rings, points, nodes, arcs, edges, idBytes;
+        uint64_t boundaryOffset, ringsOffset, nodesOffset, arcStartsOffset;
+        uint64_t arcsOffset, edgesOffset, recordsOffset, idsOffset;
+    };
+
+    struct RecordEntry {
+        double aspect, maxClearance;
+        uint64_t firstRing, ringCount, firstNode, nodeCount, firstEdge, edgeCount;
+        uint64_t idOffset, idLength;
+    };
+
+    static_assert(sizeof(Header) == 160 && sizeof(RecordEntry) == 80, "skeleton store layout changed");
+    static_assert(sizeof(liblabel::Point) == 16 && sizeof(liblabel::SkeletonArc) == 8
+                  && sizeof(liblabel::SkeletonEdgeData) == 16, "records are written as they are");
+
+    // The sections streamed to temporary files, in file order
+    enum SectionIndex { BOUNDARY, RINGS, NODES, ARC_STARTS, ARCS, EDGES, SECTION_COUNT };
+
+    // Whether [offset, offset + count * size) lies within length bytes
+    bool fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t length) {
+        return offset <= length && offset % 8 == 0 && count <= (length - offset) / size;
+    }
+
+    // Whether the table of count + 1 starts is non-decreasing from 0 to total
+    bool isStartTable(const uint64_t* starts, uint64_t count, uint64_t total) {
+        if(starts[0] != 0 || starts[count] != total) {
+            return false;
+        }
+        for(uint64_t i = 0; i < count; ++i) {
+            if(starts[i] > starts[i + 1]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    const RecordEntry& entry(const void* records, size_t index) {
+        return static_cast<const RecordEntry*>(records)[index];
+    }
+}
+
+std::string_view liblabel::SkeletonRecordView::id() const {
+    const RecordEntry& e = entry(reader->records, index);
+    return {reader->ids + e.idOffset, e.idLength};
+}
+
+liblabel::Aspect liblabel::SkeletonRecordView::aspect() const {
+    return entry(reader->records, index).aspect;
+}
+
+bool liblabel::SkeletonRecordView::hasSkeleton() const {
+    return entry(reader->records, index).ringCount > 0;
+}
+
+liblabel::SkeletonGraphView liblabel::SkeletonRecordView::graph() const {
+    const RecordEntry& e = entry(reader->records, index);
+    // The ring and arc tables hold global indices, which are the offsets of
+    // the views as they start at the first point and arc of the file
+    const double* coords = reinterpret_cast<const double*>(reader->boundary);
+    return {
+        {coords, coords + 1, 2, reinterpret_cast<const size_t*>(reader->ringStarts + e.firstRing), e.ringCount},
+        e.maxClearance,
+        reader->nodes + e.firstNode, e.nodeCount,
+        reader->arcStarts + e.firstNode, reader->arcs,
+        reader->edges + e.firstEdge, e.edgeCount
+    };
+}
+
+liblabel::SkeletonStoreReader::SkeletonStoreReader(const std::string& path) {
+    if(sizeof(size_t) != sizeof(uint64_t)) {
+        throw std::runtime_error("Skeleton stores need 64 bit offsets");
+    }
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if(fd < 0) {
+        throw std::runtime_error("Could not open the skeleton store " + path);
+    }
+    struct stat st;
+    if(::fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error("Not a skeleton store: " + path);
+    }
+    length = st.st_size;
+    void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mapped == MAP_FAILED) {
+        throw std::runtime_error("Could not map the skeleton store " + path);
+    }
+    data = static_cast<const unsigned char*>(mapped);
+
+    auto invalid = [&](const std::string& reason) {
+        ::munmap(const_cast<unsigned char*>(data), length);
+        return std::runtime_error("Invalid skeleton store " + path + ": " + reason);
+    };
+
+    Header h;
+    std::memcpy(&h, data, sizeof(h));
+    if(std::memcmp(h.magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        throw invalid("bad magic");
+    }
+    if(h.version != FORMAT_VERSION) {
+        throw invalid("unsupported version " + std::to_string(h.version));
+    }
+    if(h.byteOrder != BYTE_ORDER_MARK) {
+        throw invalid("written with a different byte order");
+    }
+    const uint64_t maxCount = std::numeric_limits<uint64_t>::max() - 1;
+    if(h.rings > maxCount || h.nodes > maxCount
+       || !fits(h.boundaryOffset, h.points, sizeof(Point), length)
+       || !fits(h.ringsOffset, h.rings + 1, sizeof(uint64_t), length)
+       || !fits(h.nodesOffset, h.nodes, sizeof(Point), length)
+       || !fits(h.arcStartsOffset, h.nodes + 1, sizeof(uint64_t), length)
+       || !fits(h.arcsOffset, h.arcs, sizeof(SkeletonArc), length)
+       || !fits(h.edgesOffset, h.edges, sizeof(SkeletonEdgeData), length)
+       || !fits(h.recordsOffset, h.records, sizeof(RecordEntry), length)
+       || !fits(h.idsOffset, h.idBytes, 1, length)) {
+        throw invalid("truncated");
+    }
+    storedConfig.vertexBudget = h.vertexBudget;
+    storedConfig.sampling = Config::Sampling(h.sampling);
+    storedConfig.skeleton = Config::Skeleton(h.skeleton);
+    storedConfig.simplifyTolerance = h.simplifyTolerance;
+
+    recordCount = h.records;
+    boundary = reinterpret_cast<const Point*>(data + h.boundaryOffset);
+    ringStarts = reinterpret_cast<const uint64_t*>(data + h.ringsOffset);
+    nodes = reinterpret_cast<const Point*>(data + h.nodesOffset);
+    arcStarts = reinterpret_cast<const uint64_t*>(data + h.arcStartsOffset);
+    arcs = reinterpret_cast<const SkeletonArc*>(data + h.arcsOffset);
+    edges = reinterpret_cast<const SkeletonEdgeData*>(data + h.edgesOffset);
+    records = data + h.recordsOffset;
+    ids = reinterpret_cast<const char*>(data + h.idsOffset);
+
+    // Checking the tables once keeps the accessors free of bounds checks.
+    // The arcs are checked by computeLabel when a graph is loaded.
+    if(!isStartTable(ringStarts, h.rings, h.points)) {
+        throw invalid("inconsistent ring table");
+    }
+    if(!isStartTable(arcStarts, h.nodes, h.arcs)) {
+        throw invalid("inconsistent arc table");
+    }
+    for(size_t i = 0; i < recordCount; ++i) {
+        const RecordEntry& e = entry(records, i);
+        if(e.firstRing > h.rings || e.ringCount > h.rings - e.firstRing
+           || e.firstNode > h.nodes || e.nodeCount > h.nodes - e.firstNode
+           || e.firstEdge > h.edges || e.edgeCount > h.edges - e.firstEdge
+           || e.idOffset > h.idBytes || e.idLength > h.idBytes - e.idOffset) {
+            throw invalid("inconsistent record " + std::to_string(i));
+        }
+    }
+}
+
+liblabel::SkeletonStoreReader::~SkeletonStoreReader() {
+    ::munmap(const_cast<unsigned char*>(data), length);
+}
+
+liblabel::SkeletonRecordView liblabel::SkeletonStoreReader::operator[](size_t record) const {
+    SkeletonRecordView view;
+    view.reader = this;
+    view.index = record;
+    return view;
+}
+
+struct liblabel::SkeletonStoreWriter::Section {
+    std::string path;
+    std::ofstream out;
+
+    template <class T>
+    void write(const T* values, size_t count) {
+        out.write(reinterpret_cast<const char*>(values), count * sizeof(T));
+    }
+};
+
+liblabel::SkeletonStoreWriter::SkeletonStoreWriter(const std::string& path, const Config& config)
+        : path(path), config(config), sections(SECTION_COUNT) {
+    for(size_t i = 0; i < sections.size(); ++i) {
+        sections[i].path = path + ".part" + std::to_string(i);
+        sections[i].out.open(sections[i].path, std::ios::binary | std::ios::trunc);
+        if(!sections[i].out) {
+            throw std::runtime_error("Could not create the skeleton store " + sections[i].path);
+        }
+    }
+}
+
+liblabel::SkeletonStoreWriter::~SkeletonStoreWriter() {
+    if(!finished) {
+        try {
+            finish();
+        } catch(...) {
+        }
+    }
+    for(auto& section : sections) {
+        std::remove(section.path.c_str());
+    }
+}
+
+void liblabel::SkeletonStoreWriter::add(std::string_view id, Aspect aspect, const SkeletonGraph& graph) {
+    if(finished) {
+        throw std::logic_error("The skeleton store is already finished");
+    }
+    if(graph.ringOffsets.size() < 2 || graph.ringOffsets.front() != 0 || graph.ringOffsets.back() != graph.boundary.size()
+       || graph.arcStarts.size() != graph.nodes.size() + 1 || graph.arcStarts.back() != graph.arcs.size()) {
+        throw std::invalid_argument("Inconsistent skeleton graph of " + std::string(id));
+    }
+
+    RecordEntry e{aspect, graph.maxClearance, rings, graph.ringOffsets.size() - 1,
+                  nodes, graph.nodes.size(), edges, graph.edges.size(), ids.size(), id.size()};
+
+    // Ring and arc starts are stored as global indices
+    auto& ringStarts = sections[RINGS];
+    for(size_t r = 0; r + 1 < graph.ringOffsets.size(); ++r) {
+        uint64_t start = points + graph.ringOffsets[r];
+        ringStarts.write(&start, 1);
+    }
+    auto& arcStarts = sections[ARC_STARTS];
+    for(size_t v = 0; v < graph.nodes.size(); ++v) {
+        uint64_t start = arcs + graph.arcStarts[v];
+        arcStarts.write(&start, 1);
+    }
+    sections[BOUNDARY].write(graph.boundary.data(), graph.boundary.size());
+    sections[NODES].write(graph.nodes.data(), graph.nodes.size());
+    sections[ARCS].write(graph.arcs.data(), graph.arcs.size());
+    sections[EDGES].write(graph.edges.data(), graph.edges.size());
+
+    points += graph.boundary.size();
+    rings += e.ringCount;
+    nodes += graph.nodes.size();
+    arcs += graph.arcs.size();
+    edges += graph.edges.size();
+    entries.append(reinterpret_cast<const char*>(&e), sizeof(e));
+    ids.append(id);
+    for(const auto& section : sections) {
+        if(!section.out) {
+            throw std::runtime_error("Could not write the skeleton store");
+        }
+    }
+}
+
+void liblabel::SkeletonStoreWriter::addMissing(std::string_view id, Aspect aspect) {
+    if(finished) {
+        throw std::logic_error("The skeleton store is already finished");
+    }
+    RecordEntry e{aspect, 0, rings, 0, nodes, 0, edges, 0, ids.size(), id.size()};
+    entries.append(reinterpret_cast<const char*>(&e), sizeof(e));
+    ids.append(id);
+}
+
+void liblabel::SkeletonStoreWriter::finish() {
+    if(finished) {
+        return;
+    }
+    finished = true;
+
+    // The start tables end with the totals
+    sections[RINGS].write(&points, 1);
+    sections[ARC_STARTS].write(&arcs, 1);
+    for(auto& section : sections) {
+        section.out.close();
+        if(!section.out) {
+            throw std::runtime_error("Could not write the skeleton store");
+        }
+    }
+
+    Header h{};
+    std::memcpy(h.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    h.version = FORMAT_VERSION;
+    h.byteOrder = BYTE_ORDER_MARK;
+    h.vertexBudget = config.vertexBudget;
+    h.sampling = uint32_t(config.sampling);
+    h.skeleton = uint32_t(config.skeleton);
+    h.simplifyTolerance = config.simplifyTolerance;
+    h.records = entries.size() / sizeof(RecordEntry);
+    h.rings = rings;
+    h.points = points;
+    h.nodes = nodes;
+    h.arcs = arcs;
+    h.edges = edges;
+    h.idBytes = ids.size();
+
+    // Every entry of the sections takes a multiple of 8 bytes, so all
+    // sections stay aligned
+    h.boundaryOffset = sizeof(Header);
+    h.ringsOffset = h.boundaryOffset + points * sizeof(Point);
+    h.nodesOffset = h.ringsOffset + (rings + 1) * sizeof(uint64_t);
+    h.arcStartsOffset = h.nodesOffset + nodes * sizeof(Point);
+    h.arcsOffset = h.arcStartsOffset + (nodes + 1) * sizeof(uint64_t);
+    h.edgesOffset = h.arcsOffset + arcs * sizeof(SkeletonArc);
+    h.recordsOffset = h.edgesOffset + edges * sizeof(SkeletonEdgeData);
+    h.idsOffset = h.recordsOffset + entries.size();
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    for(auto& section : sections) {
+        std::ifstream in(section.path, std::ios::binary);
+        // Inserting an empty buffer would set the failbit
+        if(in.peek() != std::ifstream::traits_type::eof()) {
+            out << in.rdbuf();
+        }
+        in.close();
+        std::remove(section.path.c_str());
+    }
+    out.write(entries.data(), entries.size());
+    out.write(ids.data(), ids.size());
+    out.close();
+    if(!out) {
+        throw std::runtime_error("Could not write the skeleton store " + path);
+    }
+}
@@ -1,19 +1,28 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <iostream>
+#include <limits>
 #include <math.h>
+#include <mutex>
+#include <stdexcept>
 
 #include "liblabeling.h"
 
 #include "circle_apx.hpp"
+#include "compact_graph.hpp"
+#include "csr_graph.hpp"
 #include "label_fit.hpp"
 #include "longest_paths.hpp"
+#include "segment_voronoi.hpp"
 #include "segments_to_graph.hpp"
+#include "subsampling.hpp"
+#include "thread_pool.hpp"
 
 #include <CGAL/Exact_predicates_inexact_constructions_kernel.h>
 #include <CGAL/Polygon_2.h>
 #include <CGAL/Polygon_with_holes_2.h>
-
-const size_t TARGET_POLY_SIZE = 100;
+#include <CGAL/Simple_cartesian.h>
 
 namespace debug {
     using namespace std;
@@ -40,209 +49,718 @@ namespace {
     using KSegment = K::Segment_2;
     using KPolygon = CGAL::Polygon_2<K>;
     using KPolyWithHoles = CGAL::Polygon_with_holes_2<K>;
+    // Kernel of Config::Kernel::Fast
+    using FK = CGAL::Simple_cartesian<double>;
 
     struct AugmentedSkeletonEdge {
         liblabel::Point src, trgt;
         double dist, clear;
+        // Skeleton vertex ids of the endpoints, see SkeletonEdge
+        size_t srcId, trgtId;
     };
 
     using Path = std::vector<liblabel::Point>;
     using Skeleton = std::vector<AugmentedSkeletonEdge>;
 
-    KPolyWithHoles constructPolygon(const liblabel::Polygon& poly);
+    // Memory used to evaluate a single candidate path in the kernel EK
+    template<class EK>
+    struct CandidateBuffers {
+        std::vector<circle_apx_nsp::Point> points;
+        circle_apx_nsp::Circle circle;
+        std::vector<label_fit::Cup<EK>> cups;
+        std::vector<typename EK::Point_2> highPoints;
+        label_fit::HighPointBuffers<typename EK::FT> highPointBuffers;
+    };
+
+    // The boundary of the polygon converted to the kernel of the path
+    // evaluation, the exact predicates kernel uses the originals
+    template<class EK>
+    struct EvaluationGeometry {
+        std::vector<typename EK::Segment_2> boundary;
+        CGAL::Polygon_2<EK> outer;
+        std::vector<CandidateBuffers<EK>> candidates;
+    };
+}
+
+struct liblabel::LabelingWorkspace::Buffers {
+    // Polygon construction
+    std::vector<std::vector<KPoint>> rings;
+    std::vector<std::vector<double>> spacings;
+    liblabel::detail::SamplingBuffers sampling;
+    std::vector<KPoint> sampledPoints;
+    KPolyWithHoles polygon;
+
+    // Skeleton construction
+    std::vector<KSegment> boundary;
+    // Conforming CDT of the boundary, emptied for every label but keeping
+    // its storage
+    CDT cdt;
+    SkeletonBuffers skeletonBuffers;
+    std::vector<SkeletonEdge> skeletonEdges;
+    Skeleton skeleton;
+    // Bound of the clearance of the points inside of the polygon: the
+    // largest circumradius of the triangulation, or the exact value for
+    // the segment Voronoi skeleton
+    double maxClearance = 0;
+
+    // Path search
+    std::vector<longest_paths::Segment> segments;
+    csr::Builder graphBuilder;
+    csr::CsrGraph graph;
+    // The graph searched if Config::compactSkeleton is set
+    csr::CompactionBuffers compactionBuffers;
+    csr::Compaction compaction;
+    csr::CsrGraph compactGraph;
+    std::vector<Node> pathNodes;
+    csr::SearchBuffers search;
+    std::vector<std::vector<Vertex>> vertexPaths;
+    std::vector<Path> paths;
+    // Edge endpoints and number of arcs of a stored skeleton graph
+    std::vector<std::pair<Vertex, Vertex>> edgeEnds;
+    std::vector<unsigned char> edgeArcs;
+
+    // Path evaluation, one slot per candidate
+    std::vector<CandidateBuffers<K>> candidates;
+    EvaluationGeometry<FK> fast;
+    std::vector<std::optional<liblabel::AreaLabel>> candidateLabels;
+    std::vector<double> candidateBounds;
+    std::vector<size_t> candidateOrder;
+};
+
+liblabel::LabelingWorkspace::LabelingWorkspace() : impl(std::make_unique<Buffers>()) {}
+liblabel::LabelingWorkspace::~LabelingWorkspace() = default;
+liblabel::LabelingWorkspace::LabelingWorkspace(LabelingWorkspace&&) noexcept = default;
+liblabel::LabelingWorkspace& liblabel::LabelingWorkspace::operator=(LabelingWorkspace&&) noexcept = default;
+
+namespace {
+    using Workspace = liblabel::LabelingWorkspace::Buffers;
+
+    // Measures the wall time since construction or the last lap
+    class Stopwatch {
+    public:
+        double lap() {
+            auto now = std::chrono::steady_clock::now();
+            double seconds = std::chrono::duration<double>(now - start).count();
+            start = now;
+            return seconds;
+        }
+
+    private:
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    };
+
+    // End of the time budget of a labeling call. Once a check found the
+    // deadline passed it stays expired, which marks the result as partial.
+    class Deadline {
+    public:
+        explicit Deadline(double budget)
+            : limited(budget > 0),
+              end(std::chrono::steady_clock::now()
+                  + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(budget))) {}
+
+        bool passed() {
+            if(limited && !hit && std::chrono::steady_clock::now() >= end) {
+                hit = true;
+            }
+            return hit;
+        }
+
+        bool expired() const { return hit; }
+
+        bool isLimited() const { return limited; }
+
+    private:
+        bool limited;
+        std::chrono::steady_clock::time_point end;
+        std::atomic<bool> hit{false};
+    };
+
+    // Copy the rings of the input into ws.rings, the outer boundary first
+    void loadRings(const liblabel::Polygon& poly, Workspace& ws);
+
+    void loadRings(const liblabel::PolygonView& view, Workspace& ws);
+
+    const KPolyWithHoles& constructPolygon(const liblabel::Config& config, Workspace& ws, Deadline& deadline);
+
+    const KPolyWithHoles& polygonFromRings(Workspace& ws);
+
+    void collectBoundary(const KPolyWithHoles& ph, std::vector<KSegment>& segs);
+
+    bool constructSkeleton(const KPolyWithHoles&, const liblabel::Config&, Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats);
+
+    void constructPathGraph(const std::vector<AugmentedSkeletonEdge>&, Workspace& ws);
+
+    void compactPathGraph(const liblabel::Config&, Workspace& ws, liblabel::LabelStats& stats);
+
+    const std::vector<Path>& computeLongestPaths(const liblabel::Aspect, const liblabel::Config&, Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats);
+
+    std::optional<liblabel::AreaLabel> evaluatePaths(const std::vector<Path>&, const liblabel::Aspect, const KPolyWithHoles&, const liblabel::Config&, Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats);
+
+    size_t vertexCount(const std::vector<std::vector<KPoint>>& rings);
+
+    size_t vertexCount(const KPolyWithHoles& ph);
+
+    // Builds the polygon from the rings loaded into the workspace, its
+    // skeleton and the path graph, none of which depends on the aspect.
+    // Returns false if no skeleton could be constructed in time.
+    bool prepareGeometry(const liblabel::Config& configuration, Workspace& ws, Deadline& deadline, bool progress, liblabel::LabelStats& st) {
+        Stopwatch watch;
+
+        if(progress) std::cout << "Constructing the polygon ..." << std::endl;
+        st.inputVertices = vertexCount(ws.rings);
+        const KPolyWithHoles& ph = constructPolygon(configuration, ws, deadline);
+        st.polygonSeconds = watch.lap();
+        st.sampledVertices = vertexCount(ph);
+        if(progress) std::cout << "... finished.\nOuter polygon was supsampled to "
+                               << ph.outer_boundary().size() << " many points." << std::endl;
+
+        // Construct the skeleton
+        if(progress) std::cout << "Construncting the skeleton ..." << std:: endl;
+        watch.lap();
+        bool hasSkeleton = constructSkeleton(ph, configuration, ws, deadline, st);
+        st.skeletonSeconds = watch.lap();
+        if(progress) std::cout << "... finished" << std:: endl;
+        if(!hasSkeleton) {
+            return false;
+        }
+        if(progress) std::cout << "The computed skeleton contains " << ws.skeleton.size() << " many edges" << std::endl;
+
+        watch.lap();
+        constructPathGraph(ws.skeleton, ws);
+        compactPathGraph(configuration, ws, st);
+        st.pathSearchSeconds += watch.lap();
+        return true;
+    }
+
+    // Searches and evaluates the candidate paths of the prepared geometry for
+    // one aspect. Times and counts are added to st.
+    std::optional<liblabel::AreaLabel> labelPreparedGeometry(liblabel::Aspect aspect, const liblabel::Config& configuration, Workspace& ws, Deadline& deadline, bool progress, liblabel::LabelStats& st) {
+        Stopwatch watch;
+
+        // Find candidate paths
+        if(progress) std::cout << "Searching for longest paths ..." << std::endl;
+        const auto& paths = computeLongestPaths(aspect, configuration, ws, deadline, st);
+        st.pathSearchSeconds += watch.lap();
+        if(progress) std::cout << "... finished. Found " << paths.size() << " candidate paths" << std::endl;
+
+        // Evaluate paths
+        if(progress) std::cout << "Evaluating paths ..." << std::endl;
+        watch.lap();
+        auto res = evaluatePaths(paths, aspect, ws.polygon, configuration, ws, deadline, st);
+        st.evaluationSeconds += watch.lap();
+        if(res.has_value()) {
+            res->partial = deadline.expired();
+        }
+        if(!res.has_value()) {
+            if(progress) std::cout << "... finished without an result!" << std::endl;
+        } else {
+            if(progress) std::cout << "... finished" << std::endl;
+        }
+
+        return res;
+    }
+
+    // Labels the rings loaded into the workspace for count aspects, the
+    // labels are written to labels[0, count)
+    void labelRings(const liblabel::Aspect* aspects, size_t count, std::optional<liblabel::AreaLabel>* labels,
+                    const liblabel::Config& configuration, Workspace& ws, bool progress, liblabel::LabelStats* stats) {
+        liblabel::LabelStats localStats;
+        liblabel::LabelStats& st = stats ? *stats : localStats;
+        st = liblabel::LabelStats();
+        Deadline deadline(configuration.timeBudget);
+
+        if(count > 0 && prepareGeometry(configuration, ws, deadline, progress, st)) {
+            for(size_t i = 0; i < count; ++i) {
+                labels[i] = labelPreparedGeometry(aspects[i], configuration, ws, deadline, progress, st);
+            }
+        }
+        st.partial = deadline.expired();
+    }
+
+    // Copies the geometry built by prepareGeometry into graph. The arcs of
+    // every node are ordered by edge index like the arcs of ws.graph.
+    void storeSkeleton(const Workspace& ws, liblabel::SkeletonGraph& graph) {
+        const csr::CsrGraph& g = ws.graph;
+        size_t nodes = g.num_vertices();
+
+        graph.boundary.clear();
+        graph.ringOffsets.assign(1, 0);
+        auto addRing = [&graph](const KPolygon& ring) {
+            for(auto vit = ring.vertices_begin(); vit != ring.vertices_end(); ++vit) {
+                graph.boundary.push_back({vit->x(), vit->y()});
+            }
+            graph.ringOffsets.push_back(graph.boundary.size());
+        };
+        addRing(ws.polygon.outer_boundary());
+        for(auto hit = ws.polygon.holes_begin(), end = ws.polygon.holes_end(); hit != end; ++hit) {
+            addRing(*hit);
+        }
+        graph.maxClearance = ws.maxClearance;
 
-    std::optional<std::vector<AugmentedSkeletonEdge>> constructSkeleton(const KPolyWithHoles&);
+        graph.nodes.resize(nodes);
+        for(size_t v = 0; v < nodes; ++v) {
+            graph.nodes[v] = {g.nodes[v].x, g.nodes[v].y};
+        }
+        graph.arcStarts.assign(g.arc_begin.begin(), g.arc_begin.end());
+        graph.arcs.resize(g.num_arcs());
+        graph.edges.resize(g.edge_count);
+        for(size_t a = 0; a < g.num_arcs(); ++a) {
+            graph.arcs[a] = {g.arc_target[a], g.arc_edge[a]};
+            graph.edges[g.arc_edge[a]] = {g.arc_weight[a], g.arc_capacity[a]};
+        }
+    }
 
-    std::vector<Path> computeLongestPaths(const std::vector<AugmentedSkeletonEdge>&, const liblabel::Aspect, const liblabel::Config&);
+    // Rebuilds the geometry of prepareGeometry from a stored skeleton. The
+    // arcs are taken over in their order, so the path search finds the same
+    // paths as on the graph the skeleton was stored from.
+    void loadSkeleton(const liblabel::SkeletonGraphView& skeleton, Workspace& ws) {
+        loadRings(skeleton.boundary, ws);
+        const KPolyWithHoles& ph = polygonFromRings(ws);
+        collectBoundary(ph, ws.boundary);
+        ws.maxClearance = skeleton.maxClearance;
+
+        if(skeleton.nodeCount > 0 && (!skeleton.nodes || !skeleton.arcStarts)) {
+            throw std::invalid_argument("SkeletonGraphView without nodes");
+        }
+        if(skeleton.edgeCount > 0 && !skeleton.edges) {
+            throw std::invalid_argument("SkeletonGraphView without edges");
+        }
+        uint64_t arcs = skeleton.nodeCount > 0 ? skeleton.arcStarts[skeleton.nodeCount] : 0;
+        if(skeleton.nodeCount >= UINT32_MAX || arcs >= UINT32_MAX) {
+            throw std::length_error("Skeleton graph with more than 2^32 nodes or arcs");
+        }
 
-    std::optional<liblabel::AreaLabel> evaluatePaths(const std::vector<Path>&, const liblabel::Aspect, const KPolyWithHoles&);
+        csr::CsrGraph& g = ws.graph;
+        g.nodes.resize(skeleton.nodeCount);
+        g.arc_begin.resize(skeleton.nodeCount + 1);
+        g.arc_target.resize(arcs);
+        g.arc_edge.resize(arcs);
+        g.arc_weight.resize(arcs);
+        g.arc_capacity.resize(arcs);
+        g.edge_count = skeleton.edgeCount;
+        g.arc_begin[0] = 0;
+
+        // Every edge needs an arc at both ends, loops a single one
+        ws.edgeEnds.resize(skeleton.edgeCount);
+        ws.edgeArcs.assign(skeleton.edgeCount, 0);
+        for(size_t v = 0; v < skeleton.nodeCount; ++v) {
+            uint64_t begin = skeleton.arcStarts[v], end = skeleton.arcStarts[v + 1];
+            if(begin > end || begin != g.arc_begin[v] || (begin < end && !skeleton.arcs)) {
+                throw std::invalid_argument("SkeletonGraphView with decreasing arc starts");
+            }
+            g.nodes[v] = {skeleton.nodes[v].x, skeleton.nodes[v].y};
+            g.arc_begin[v + 1] = csr::Index(end);
+            for(uint64_t a = begin; a < end; ++a) {
+                const liblabel::SkeletonArc& arc = skeleton.arcs[a];
+                if(arc.node >= skeleton.nodeCount || arc.edge >= skeleton.edgeCount) {
+                    throw std::invalid_argument("SkeletonGraphView with an arc to a missing node or edge");
+                }
+                auto& ends = ws.edgeEnds[arc.edge];
+                unsigned char& count = ws.edgeArcs[arc.edge];
+                if(count == 0) {
+                    ends = {v, arc.node};
+                } else if(count > 1 || ends.first == ends.second || ends != std::pair<Vertex, Vertex>(arc.node, v)) {
+                    throw std::invalid_argument("SkeletonGraphView with unmatched arcs");
+                }
+                ++count;
+                g.arc_target[a] = arc.node;
+                g.arc_edge[a] = arc.edge;
+                g.arc_weight[a] = skeleton.edges[arc.edge].weight;
+                g.arc_capacity[a] = skeleton.edges[arc.edge].capacity;
+            }
+        }
+        for(size_t i = 0; i < skeleton.edgeCount; ++i) {
+            auto [u, v] = ws.edgeEnds[i];
+            if(ws.edgeArcs[i] != (u == v ? 1 : 2)) {
+                throw std::invalid_argument("SkeletonGraphView with an edge without arcs");
+            }
+        }
+    }
 }
 
 std::optional<liblabel::AreaLabel> liblabel::computeLabel(
         liblabel::Aspect aspect,
-        Polygon& poly,
+        const Polygon& poly,
         bool progress,
-        liblabel::Config configuration
+        liblabel::Config configuration,
+        LabelStats* stats
     ){
-    if(progress) std::cout << "Constructing the polygon ..." << std::endl;
-    KPolyWithHoles ph = constructPolygon(poly);
-    if(progress) std::cout << "... finished.\nOuter polygon was supsampled to "
-                           << ph.outer_boundary().size() << " many points." << std::endl;
-
-    // Construct the skeleton
-    if(progress) std::cout << "Construncting the skeleton ..." << std:: endl;
-    auto skeletonOp = constructSkeleton(ph);
-    if(progress) std::cout << "... finished" << std:: endl;
-    if(!skeletonOp.has_value()) {
-        return {};
-    }
-    if(progress) std::cout << "The computed skeleton contains " << skeletonOp.value().size() << " many edges" << std::endl;
-
-    // Find candidate paths
-    if(progress) std::cout << "Searching for longest paths ..." << std::endl;
-    auto paths = computeLongestPaths(skeletonOp.value(), aspect, configuration);
-    if(progress) std::cout << "... finished. Found " << paths.size() << " candidate paths" << std::endl;
-
-    // Evaluate paths
-    if(progress) std::cout << "Evaluating paths ..." << std::endl;
-    auto res = evaluatePaths(paths, aspect, ph);
-    if(!res.has_value()) {
-        if(progress) std::cout << "... finished without an result!" << std::endl;
-    } else {
-        if(progress) std::cout << "... finished" << std::endl;
-    }
+    LabelingWorkspace workspace;
+    return computeLabel(aspect, poly, workspace, progress, configuration, stats);
+}
+
+std::optional<liblabel::AreaLabel> liblabel::computeLabel(
+        liblabel::Aspect aspect,
+        const Polygon& poly,
+        LabelingWorkspace& workspace,
+        bool progress,
+        liblabel::Config configuration,
+        LabelStats* stats
+    ){
+    Workspace& ws = workspace.buffers();
+    loadRings(poly, ws);
+    std::optional<AreaLabel> label;
+    labelRings(&aspect, 1, &label, configuration, ws, progress, stats);
+    return label;
+}
 
-    return res;
+std::optional<liblabel::AreaLabel> liblabel::computeLabel(
+        liblabel::Aspect aspect,
+        const PolygonView& view,
+        bool progress,
+        liblabel::Config configuration,
+        LabelStats* stats
+    ){
+    LabelingWorkspace workspace;
+    return computeLabel(aspect, view, workspace, progress, configuration, stats);
 }
 
+std::optional<liblabel::AreaLabel> liblabel::computeLabel(
+        liblabel::Aspect aspect,
+        const PolygonView& view,
+        LabelingWorkspace& workspace,
+        bool progress,
+        liblabel::Config configuration,
+        LabelStats* stats
+    ){
+    Workspace& ws = workspace.buffers();
+    loadRings(view, ws);
+    std::optional<AreaLabel> label;
+    labelRings(&aspect, 1, &label, configuration, ws, progress, stats);
+    return label;
+}
 
-namespace {
-    double segLength(const KSegment& seg) {
-        return sqrt(CGAL::squared_distance(seg.source(), seg.target()));
+liblabel::SkeletonGraphView liblabel::SkeletonGraph::view() const {
+    const double* coords = boundary.empty() ? nullptr : &boundary[0].x;
+    return {
+        {coords, coords ? coords + 1 : nullptr, 2, ringOffsets.data(), ringOffsets.empty() ? 0 : ringOffsets.size() - 1},
+        maxClearance,
+        nodes.data(), nodes.size(),
+        arcStarts.data(), arcs.data(),
+        edges.data(), edges.size()
+    };
+}
+
+bool liblabel::computeSkeleton(
+        const Polygon& poly,
+        SkeletonGraph& graph,
+        LabelingWorkspace& workspace,
+        liblabel::Config configuration,
+        LabelStats* stats
+    ){
+    Workspace& ws = workspace.buffers();
+    loadRings(poly, ws);
+    liblabel::LabelStats localStats;
+    liblabel::LabelStats& st = stats ? *stats : localStats;
+    st = liblabel::LabelStats();
+    Deadline deadline(configuration.timeBudget);
+
+    bool prepared = prepareGeometry(configuration, ws, deadline, false, st);
+    st.partial = deadline.expired();
+    if(!prepared) {
+        return false;
     }
+    storeSkeleton(ws, graph);
+    return true;
+}
 
-    std::vector<KPoint> supsampleSegment(const KSegment& seg, double precision) {
-        auto s = seg.source();
-        auto t = seg.target();
+std::optional<liblabel::AreaLabel> liblabel::computeLabel(
+        liblabel::Aspect aspect,
+        const SkeletonGraphView& skeleton,
+        LabelingWorkspace& workspace,
+        bool progress,
+        liblabel::Config configuration,
+        LabelStats* stats
+    ){
+    Workspace& ws = workspace.buffers();
+    liblabel::LabelStats localStats;
+    liblabel::LabelStats& st = stats ? *stats : localStats;
+    st = liblabel::LabelStats();
+
+    Stopwatch watch;
+    loadSkeleton(skeleton, ws);
+    st.inputVertices = st.sampledVertices = vertexCount(ws.rings);
+    st.skeletonEdges = skeleton.edgeCount;
+    st.polygonSeconds = watch.lap();
+    compactPathGraph(configuration, ws, st);
+    st.pathSearchSeconds += watch.lap();
+
+    Deadline deadline(configuration.timeBudget);
+    auto label = labelPreparedGeometry(aspect, configuration, ws, deadline, progress, st);
+    st.partial = deadline.expired();
+    return label;
+}
 
-        double dist = segLength(seg);
-        size_t target = (size_t) ceil(dist / precision) - 1; // nr of points to insert
+std::vector<std::optional<liblabel::AreaLabel>> liblabel::computeLabelsForAspects(
+        const std::vector<Aspect>& aspects,
+        const Polygon& poly,
+        bool progress,
+        liblabel::Config configuration,
+        LabelStats* stats
+    ){
+    LabelingWorkspace workspace;
+    return computeLabelsForAspects(aspects, poly, workspace, progress, configuration, stats);
+}
 
-        double stepX = (t.x() - s.x()) / (target + 1);
-        double stepY = (t.y() - s.y()) / (target + 1);
+std::vector<std::optional<liblabel::AreaLabel>> liblabel::computeLabelsForAspects(
+        const std::vector<Aspect>& aspects,
+        const Polygon& poly,
+        LabelingWorkspace& workspace,
+        bool progress,
+        liblabel::Config configuration,
+        LabelStats* stats
+    ){
+    Workspace& ws = workspace.buffers();
+    loadRings(poly, ws);
+    std::vector<std::optional<AreaLabel>> labels(aspects.size());
+    labelRings(aspects.data(), aspects.size(), labels.data(), configuration, ws, progress, stats);
+    return labels;
+}
 
-        std::vector<KPoint> res;
-        res.emplace_back(s);
-        for (size_t i = 1; i <= target; ++i) {
-            res.emplace_back(s.x() + i*stepX, s.y() + i*stepY);
-        }
-        res.emplace_back(t);
 
-        return res;
+namespace {
+    void toRing(const liblabel::Polyline& pl, std::vector<KPoint>& ring) {
+        ring.clear();
+        std::transform(pl.points.begin(), pl.points.end(),
+            std::back_inserter(ring),
+            [](liblabel::Point p) -> KPoint { return {p.x, p.y}; });
     }
 
-    KPolygon supsampleSimplePolygon(const KPolygon& poly, double precision) {
-        std::vector<KPoint> res;
-        for(auto eit = poly.edges_begin(), end = poly.edges_end(); eit != end; ++eit) {
-            auto sups = supsampleSegment(*eit, precision);
-            sups.pop_back();
-            res.insert(res.end(), sups.begin(), sups.end());
+    // Builds the supsampled polygon inside of the workspace
+    void loadRings(const liblabel::Polygon& poly, Workspace& ws) {
+        ws.rings.resize(1 + poly.holes.size());
+        toRing(poly.outer, ws.rings[0]);
+        for(size_t i = 0; i < poly.holes.size(); ++i) {
+            toRing(poly.holes[i], ws.rings[i + 1]);
         }
+    }
 
-        return KPolygon(res.begin(), res.end());
+    void loadRings(const liblabel::PolygonView& view, Workspace& ws) {
+        if(view.ringCount == 0 || !view.ringOffsets) {
+            throw std::invalid_argument("PolygonView without an outer boundary");
+        }
+        // All offsets are checked before any point is read, so a broken one
+        // cannot make the loop below read outside of the buffers
+        for(size_t r = 0; r < view.ringCount; ++r) {
+            if(view.ringOffsets[r] > view.ringOffsets[r + 1]) {
+                throw std::invalid_argument("PolygonView with decreasing ring offsets");
+            }
+        }
+        if(view.ringOffsets[view.ringCount] > 0 && (!view.x || !view.y)) {
+            throw std::invalid_argument("PolygonView without coordinates");
+        }
+        ws.rings.resize(view.ringCount);
+        for(size_t r = 0; r < view.ringCount; ++r) {
+            size_t begin = view.ringOffsets[r], end = view.ringOffsets[r + 1];
+            auto& ring = ws.rings[r];
+            ring.clear();
+            for(size_t i = begin; i < end; ++i) {
+                ring.emplace_back(view.x[i * view.stride], view.y[i * view.stride]);
+            }
+        }
     }
 
-    double polyLength(const KPolygon& poly) {
-        double dist = 0;
+    const KPolyWithHoles& constructPolygon(const liblabel::Config& config, Workspace& ws, Deadline& deadline) {
+        using namespace liblabel::detail;
 
-        for(auto eit = poly.edges_begin(), end = poly.edges_end(); eit != end; ++eit) {
-            dist += segLength(*eit);
+        if(config.simplifyTolerance > 0) {
+            double spacing = outerSpacing(ws.rings, config.vertexBudget);
+            for(auto& ring : ws.rings) {
+                simplifyRing(ring, config.simplifyTolerance * spacing, ws.sampling);
+            }
         }
 
-        return dist;
-    }
+        if(config.skeleton == liblabel::Config::Skeleton::SegmentVoronoi) {
+            return polygonFromRings(ws);
+        }
+
+        bool adaptive = config.sampling == liblabel::Config::Sampling::Adaptive;
+        edgeSpacings(ws.rings, config.vertexBudget, adaptive, ws.spacings, ws.sampling, [&deadline]() { return deadline.passed(); });
 
-    KPolyWithHoles supsamplePolygon(const KPolyWithHoles& poly, size_t target_size) {
-        double precision = polyLength(poly.outer_boundary()) / target_size;
+        ws.polygon.clear();
+        supsampleRing(ws.rings[0], ws.spacings[0], ws.sampledPoints);
+        auto& outer = ws.polygon.outer_boundary();
+        for(const auto& p : ws.sampledPoints) {
+            outer.push_back(p);
+        }
 
-        KPolygon supsOuter = supsampleSimplePolygon(poly.outer_boundary(), precision);
-        std::vector<KPolygon> supsHoles;
-        for(auto hit = poly.holes_begin(), end = poly.holes_end(); hit != end; ++hit) {
-            supsHoles.push_back(supsampleSimplePolygon(*hit, precision));
+        for(size_t i = 1; i < ws.rings.size(); ++i) {
+            supsampleRing(ws.rings[i], ws.spacings[i], ws.sampledPoints);
+            ws.polygon.add_hole(KPolygon(ws.sampledPoints.begin(), ws.sampledPoints.end()));
         }
 
-        return KPolyWithHoles(supsOuter, supsHoles.begin(), supsHoles.end());
+        return ws.polygon;
     }
 
-    KPolyWithHoles constructPolygon(const liblabel::Polygon& poly) {
-        std::vector<KPoint> tempPts;
-        std::transform(poly.outer.points.begin(), poly.outer.points.end(),
-            std::back_inserter(tempPts),
-            [](liblabel::Point p) -> KPoint { return {p.x, p.y}; });
-        KPolygon outer(tempPts.begin(), tempPts.end());
-        std::vector<KPolygon> holes;
-        for(liblabel::Polyline hole : poly.holes){
-            tempPts.clear();
-            std::transform(hole.points.begin(), hole.points.end(),
-                std::back_inserter(tempPts),
-                [](liblabel::Point p) -> KPoint { return {p.x, p.y}; });
-            holes.emplace_back(tempPts.begin(), tempPts.end());
-        }
-
-        return supsamplePolygon(
-            KPolyWithHoles(outer, holes.begin(), holes.end()),
-            TARGET_POLY_SIZE
-        );
+    // Builds the polygon from the rings as they are
+    const KPolyWithHoles& polygonFromRings(Workspace& ws) {
+        ws.polygon.clear();
+        auto& outer = ws.polygon.outer_boundary();
+        for(const auto& p : ws.rings[0]) {
+            outer.push_back(p);
+        }
+        for(size_t i = 1; i < ws.rings.size(); ++i) {
+            ws.polygon.add_hole(KPolygon(ws.rings[i].begin(), ws.rings[i].end()));
+        }
+        return ws.polygon;
     }
 
-    std::optional<std::vector<AugmentedSkeletonEdge>> constructSkeleton(const KPolyWithHoles& ph) {
-        if(ph.outer_boundary().size() == 0) {
-            return {};
+    size_t vertexCount(const std::vector<std::vector<KPoint>>& rings) {
+        size_t count = 0;
+        for(const auto& ring : rings) {
+            count += ring.size();
+        }
+        return count;
+    }
+
+    size_t vertexCount(const KPolyWithHoles& ph) {
+        size_t count = ph.outer_boundary().size();
+        for(auto hit = ph.holes_begin(), end = ph.holes_end(); hit != end; ++hit) {
+            count += hit->size();
         }
+        return count;
+    }
 
-        std::vector<KSegment> cgal_segs;
+    void collectBoundary(const KPolyWithHoles& ph, std::vector<KSegment>& segs) {
+        segs.clear();
         std::copy(ph.outer_boundary().edges_begin(),
             ph.outer_boundary().edges_end(),
-            std::back_inserter(cgal_segs));
+            std::back_inserter(segs));
         for(auto hit = ph.holes_begin(), end = ph.holes_end(); hit != end; ++hit) {
             std::copy(hit->edges_begin(), hit->edges_end(),
-                std::back_inserter(cgal_segs));
+                std::back_inserter(segs));
         }
+    }
 
-        CDT cdt(cgal_segs.begin(), cgal_segs.end());
+    // Skeleton edges of the conforming CDT of the boundary, also sets
+    // ws.maxClearance
+    bool cdtSkeleton(Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats) {
+        CDT& cdt = ws.cdt;
+        clear_keeping_storage(cdt);
+        // With a time budget the constraints are inserted one by one to check
+        // the deadline in between
+        if(deadline.isLimited()) {
+            for(const auto& seg : ws.boundary) {
+                if(deadline.passed()) {
+                    return false;
+                }
+                cdt.insert_constraint(seg.source(), seg.target());
+            }
+        } else {
+            cdt.insert_constraints(ws.boundary.begin(), ws.boundary.end());
+        }
         if(!cdt.is_valid()) {
-            return {};
+            return false;
         }
-        auto skeleton_edges = compute_skeleton_edges(cdt);
+        auto steinerPoints = compute_skeleton_edges(cdt, ws.skeletonEdges, ws.skeletonBuffers, [&deadline]() { return deadline.passed(); });
+        if(!steinerPoints.has_value()) {
+            return false;
+        }
+        stats.steinerPoints = *steinerPoints;
 
-        std::vector<AugmentedSkeletonEdge> res;
-        std::transform(skeleton_edges.begin(), skeleton_edges.end(),
-            std::back_inserter(res),
-            [](SkeletonEdge e) -> AugmentedSkeletonEdge { return {{e.p.x(), e.p.y()}, {e.q.x(), e.q.y()}, CGAL::squared_distance(e.p, e.q), e.d};});
-        return res;
+        ws.maxClearance = 0;
+        for(auto fit = cdt.finite_faces_begin(); fit != cdt.finite_faces_end(); ++fit) {
+            double r2 = CGAL::squared_distance(cdt.circumcenter(fit), fit->vertex(0)->point());
+            ws.maxClearance = std::max(ws.maxClearance, std::sqrt(r2));
+        }
+        return true;
+    }
+
+    // Writes the skeleton into ws.skeleton, returns false if it could not
+    // be constructed before the deadline
+    bool constructSkeleton(const KPolyWithHoles& ph, const liblabel::Config& config, Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats) {
+        if(ph.outer_boundary().size() == 0) {
+            return false;
+        }
+
+        collectBoundary(ph, ws.boundary);
+        if(config.skeleton == liblabel::Config::Skeleton::SegmentVoronoi) {
+            // The rings are the boundary of ph, see constructPolygon
+            auto maxClearance = segment_voronoi::compute_skeleton_edges(ws.rings, ws.skeletonEdges, [&deadline]() { return deadline.passed(); });
+            if(!maxClearance.has_value()) {
+                return false;
+            }
+            ws.maxClearance = *maxClearance;
+        } else if(!cdtSkeleton(ws, deadline, stats)) {
+            return false;
+        }
+        stats.skeletonEdges = ws.skeletonEdges.size();
+
+        ws.skeleton.clear();
+        std::transform(ws.skeletonEdges.begin(), ws.skeletonEdges.end(),
+            std::back_inserter(ws.skeleton),
+            [](const SkeletonEdge& e) -> AugmentedSkeletonEdge { return {{e.p.x(), e.p.y()}, {e.q.x(), e.q.y()}, CGAL::squared_distance(e.p, e.q), e.d, e.p_id, e.q_id};});
+        return true;
     }
 
-    std::vector<Path> computeLongestPaths(const std::vector<AugmentedSkeletonEdge>& augSkelEdges, const liblabel::Aspect aspect, const liblabel::Config& config) {
-        std::vector<longest_paths::Segment> segs;
+    void constructPathGraph(const std::vector<AugmentedSkeletonEdge>& augSkelEdges, Workspace& ws) {
+        ws.segments.clear();
         std::transform(augSkelEdges.begin(), augSkelEdges.end(),
-            std::back_inserter(segs),
-            [](AugmentedSkeletonEdge e) -> longest_paths::Segment { return {{e.src.x, e.src.y}, {e.trgt.x, e.trgt.y}, e.dist, e.clear};});
-        auto graph = from_edges(segs);
-
-        auto paths = find_distinct_paths(graph, aspect, config.stepSize, config.numberOfPaths);
-        
-        std::vector<Path> res;
-        std::transform(paths.begin(), paths.end(),
-            std::back_inserter(res),
-            [&graph](auto path) -> Path {
-                Path res;
-                std::transform(path.begin(), path.end(),
-                    std::back_inserter(res),
-                    [&graph](auto p) -> liblabel::Point {return {graph[p].x, graph[p].y};});
-                return res;
-            });
-        return res;
+            std::back_inserter(ws.segments),
+            [](const AugmentedSkeletonEdge& e) -> longest_paths::Segment { return {{e.src.x, e.src.y}, {e.trgt.x, e.trgt.y}, e.dist, e.clear, e.srcId, e.trgtId};});
+        csr::from_edges(ws.segments, ws.graph, ws.graphBuilder);
+    }
+
+    // Compacts the graph built by constructPathGraph into ws.compactGraph if
+    // the config asks for it
+    void compactPathGraph(const liblabel::Config& config, Workspace& ws, liblabel::LabelStats& stats) {
+        stats.graphVertices = stats.compactVertices = ws.graph.num_vertices();
+        stats.graphEdges = stats.compactEdges = ws.graph.edge_count;
+        stats.prunedSpurs = 0;
+        if(!config.compactSkeleton) {
+            return;
+        }
+        csr::compact(ws.graph, ws.compactGraph, ws.compaction, ws.compactionBuffers);
+        stats.compactVertices = ws.compactGraph.num_vertices();
+        stats.compactEdges = ws.compactGraph.edge_count;
+        stats.prunedSpurs = ws.compaction.pruned_spurs;
     }
 
-    std::optional<KPoint> computeOptPlacement(const circle_apx_nsp::Circle& c, const liblabel::Aspect aspect, std::vector<K::Segment_2>& segments, const KPolyWithHoles& ph) {
-        K::Circle_2 circle = {{c.x, c.y}, c.r*c.r};
-        auto cups = compute_all_cups(segments, circle, aspect);
+    // Searches the candidate paths in the graph built by constructPathGraph,
+    // or its compaction
+    const std::vector<Path>& computeLongestPaths(const liblabel::Aspect aspect, const liblabel::Config& config, Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats) {
+        const csr::CsrGraph& graph = config.compactSkeleton ? ws.compactGraph : ws.graph;
+        stats.capacityLevels += csr::find_distinct_paths(graph, aspect, config.stepSize, config.numberOfPaths, ws.search, ws.vertexPaths,
+                                                    [&deadline]() { return deadline.passed(); });
+        stats.candidatePaths += ws.vertexPaths.size();
+
+        ws.paths.resize(ws.vertexPaths.size());
+        for(size_t i = 0; i < ws.vertexPaths.size(); ++i) {
+            ws.paths[i].clear();
+            if(config.compactSkeleton) {
+                csr::expand_path(graph, ws.compaction, ws.vertexPaths[i], ws.pathNodes);
+                std::transform(ws.pathNodes.begin(), ws.pathNodes.end(),
+                    std::back_inserter(ws.paths[i]),
+                    [](const Node& p) -> liblabel::Point {return {p.x, p.y};});
+            } else {
+                std::transform(ws.vertexPaths[i].begin(), ws.vertexPaths[i].end(),
+                    std::back_inserter(ws.paths[i]),
+                    [&graph](Vertex p) -> liblabel::Point {return {graph.nodes[p].x, graph.nodes[p].y};});
+            }
+        }
+        return ws.paths;
+    }
 
-        auto high_points_list = high_points(cups);
+    template<class EK>
+    std::optional<typename EK::Point_2> computeOptPlacement(const circle_apx_nsp::Circle& c, const liblabel::Aspect aspect, const std::vector<typename EK::Segment_2>& segments, const CGAL::Polygon_2<EK>& outer, CandidateBuffers<EK>& buffers) {
+        typename EK::Circle_2 circle = {{c.x, c.y}, c.r*c.r};
+        label_fit::compute_all_cups<EK>(segments, circle, aspect, buffers.cups);
 
-        std::vector<K::Point_2> valid_high_points;
-        std::copy_if(high_points_list.begin(), high_points_list.end(),
-                    std::back_inserter(valid_high_points), [&](Point_2 p) {
-                        return ph.outer_boundary().has_on_bounded_side(
-                            polar_point(circle, p.x()));
-                    });
+        label_fit::high_points<EK>(buffers.cups, buffers.highPoints, buffers.highPointBuffers);
 
-        if (valid_high_points.empty()) {
-            return {};
+        // The highest point placing the label inside of the polygon, the
+        // first one in case of ties
+        std::optional<typename EK::Point_2> best;
+        for(const auto& p : buffers.highPoints) {
+            if(best.has_value() && !(best->y() < p.y())) {
+                continue;
+            }
+            if(outer.has_on_bounded_side(label_fit::polar_point(circle, p.x()))) {
+                best = p;
+            }
         }
 
-        return *std::max_element(valid_high_points.begin(), valid_high_points.end(),
-                                [](Point_2 p, Point_2 q) { return p.y() < q.y(); });
+        return best;
     }
 
     double normalizeAngle(double angle) {
@@ -253,7 +771,10 @@ namespace {
         return angle;
     }
 
-    liblabel::AreaLabel constructLabel(const circle_apx_nsp::Circle circle, KPoint pos, const liblabel::Aspect aspect) {
+    // pos is a high point: the angle of the label center and the angle the
+    // label spans to each side
+    template<class Point>
+    liblabel::AreaLabel constructLabel(const circle_apx_nsp::Circle circle, const Point& pos, const liblabel::Aspect aspect) {
         liblabel::Point center{circle.x, circle.y};
         double baseRadius = circle.r;
 
@@ -264,45 +785,170 @@ namespace {
         return {
             center, baseRadius - h, baseRadius + h,
             normalizeAngle(baseAngle - angleRange),
-            normalizeAngle(baseAngle + angleRange) 
+            normalizeAngle(baseAngle + angleRange)
         };
     }
 
-    double lblValue(liblabel::AreaLabel& l) {
+    double lblValue(const liblabel::AreaLabel& l) {
         double height = l.rad_upper - l.rad_lower;
         return height;
     }
 
-    std::optional<liblabel::AreaLabel> evaluatePaths(const std::vector<Path>& paths, const liblabel::Aspect aspect, const KPolyWithHoles& ph) {
-        std::vector<K::Segment_2> cgal_segs;
-        std::copy(ph.outer_boundary().edges_begin(),
-            ph.outer_boundary().edges_end(),
-            std::back_inserter(cgal_segs));
-        for(auto hit = ph.holes_begin(), end = ph.holes_end(); hit != end; ++hit) {
-            std::copy(hit->edges_begin(), hit->edges_end(),
-                std::back_inserter(cgal_segs));
+    template<class EK>
+    void fitCircle(const Path& path, CandidateBuffers<EK>& buffers) {
+        buffers.points.clear();
+        std::transform(path.begin(), path.end(),
+            std::back_inserter(buffers.points),
+            [](liblabel::Point p) -> circle_apx_nsp::Point { return {p.x, p.y};});
+
+        buffers.circle = apx_circle(buffers.points);
+        buffers.cups.clear();
+    }
+
+    /**
+     * Upper bound of lblValue for every label placed on the circle.
+     *
+     * The label height is 2 r x / (1 + x) with x = aspect * y, where y is the
+     * angle the label spans to each side. No cup is higher than pi, so y
+     * exceeds pi only if the boundary does not surround the center, and
+     * never exceeds 2 pi.
+     * For aspects up to 1 every boundary segment within the angular range of
+     * the label is further from the circle than half the label height, and
+     * all others are at least as far from the label center. So half the
+     * height is at most the clearance of a point inside the polygon, which
+     * is bounded by the maximal clearance found by constructSkeleton.
+     */
+    template<class EK>
+    double labelBound(const circle_apx_nsp::Circle& c, const liblabel::Aspect aspect, const CGAL::Polygon_2<EK>& outer, double maxClearance) {
+        double range = outer.has_on_bounded_side(typename EK::Point_2(c.x, c.y)) ? M_PI : 2*M_PI;
+        double x = aspect * range;
+        double bound = 2 * c.r * x / (1 + x);
+        if(aspect <= 1) {
+            bound = std::min(bound, 2 * maxClearance);
+        }
+        if(std::isnan(bound)) {
+            return INFINITY;
         }
+        // Leave room for rounding errors of the label construction
+        return bound * (1 + 1e-9);
+    }
 
-        std::vector<liblabel::AreaLabel> result;
-        for(auto path : paths) {
-            std::vector<circle_apx_nsp::Point> points;
-            std::transform(path.begin(), path.end(),
-                std::back_inserter(points),
-                [](liblabel::Point p) -> circle_apx_nsp::Point { return {p.x, p.y};});
+    template<class EK>
+    std::optional<liblabel::AreaLabel> placeLabel(const liblabel::Aspect aspect, const std::vector<typename EK::Segment_2>& cgal_segs, const CGAL::Polygon_2<EK>& outer, CandidateBuffers<EK>& buffers) {
+        auto placement = computeOptPlacement(buffers.circle, aspect, cgal_segs, outer, buffers);
+        if(!placement.has_value()) {
+            return {};
+        }
+        return constructLabel(buffers.circle, placement.value(), aspect);
+    }
 
-            auto circle = apx_circle(points);
+    // Best label found so far, ties are won by the smaller candidate index
+    // to break them as in a serial run in candidate order
+    class BestCandidate {
+    public:
+        explicit BestCandidate(size_t none) : index(none) {}
 
-            auto placement = computeOptPlacement(circle, aspect, cgal_segs, ph);
-            if(placement.has_value()) {
-                result.emplace_back(constructLabel(circle, placement.value(), aspect));
+        bool canImprove(double bound, size_t i) {
+            std::lock_guard<std::mutex> lock(mutex);
+            return value < bound || (value == bound && i < index);
+        }
+
+        void offer(double v, size_t i) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if(value < v || (value == v && i < index)) {
+                value = v;
+                index = i;
             }
         }
 
-        if(result.size() == 0) {
-            return {};
+        size_t get() const { return index; }
+
+    private:
+        std::mutex mutex;
+        double value = -INFINITY;
+        size_t index;
+    };
+
+    // Evaluates the paths in the kernel EK, outer is the outer boundary and
+    // cgal_segs are all boundary segments of the polygon
+    template<class EK>
+    std::optional<liblabel::AreaLabel> evaluatePathsIn(const std::vector<Path>& paths, const liblabel::Aspect aspect,
+                                                       const std::vector<typename EK::Segment_2>& cgal_segs, const CGAL::Polygon_2<EK>& outer,
+                                                       std::vector<CandidateBuffers<EK>>& candidates,
+                                                       const liblabel::Config& config, Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats) {
+        // Candidates are independent, each one is written to its own slot
+        if(candidates.size() < paths.size()) {
+            candidates.resize(paths.size());
+        }
+        auto& result = ws.candidateLabels;
+        result.assign(paths.size(), std::nullopt);
+
+        // Fitting the circle is cheap compared to placing the label on it, so
+        // all circles are fitted first to evaluate the candidates with the
+        // highest bound first and skip those which cannot beat the best one
+        auto& bounds = ws.candidateBounds;
+        auto& order = ws.candidateOrder;
+        bounds.resize(paths.size());
+        order.resize(paths.size());
+        for(size_t i = 0; i < paths.size(); ++i) {
+            fitCircle(paths[i], candidates[i]);
+            bounds[i] = config.pruneCandidates ? labelBound(candidates[i].circle, aspect, outer, ws.maxClearance) : INFINITY;
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(), order.end(), [&bounds](size_t i, size_t j) { return bounds[i] > bounds[j]; });
+
+        BestCandidate best(paths.size());
+        std::atomic<size_t> pruned{0};
+        auto evaluate = [&](size_t k) {
+            size_t i = order[k];
+            if(deadline.passed()) {
+                return;
+            }
+            if(!best.canImprove(bounds[i], i)) {
+                ++pruned;
+                return;
+            }
+            result[i] = placeLabel(aspect, cgal_segs, outer, candidates[i]);
+            if(result[i].has_value()) {
+                best.offer(lblValue(*result[i]), i);
+            }
+        };
+
+        size_t threads = std::min(liblabel::detail::resolveThreadCount(config.evaluationThreads), paths.size());
+        if(threads > 1) {
+            liblabel::detail::ThreadPool pool(threads - 1);
+            pool.parallelFor(paths.size(), evaluate);
+        } else {
+            for(size_t k = 0; k < paths.size(); ++k) {
+                evaluate(k);
+            }
+        }
+
+        for(size_t i = 0; i < paths.size(); ++i) {
+            stats.cups += candidates[i].cups.size();
         }
+        stats.prunedPaths += pruned;
 
-        return *std::max_element(result.begin(), result.end(),
-            [](auto l1, auto l2) { return lblValue(l1) < lblValue(l2); });
+        if(best.get() == paths.size()) {
+            return {};
+        }
+        return result[best.get()];
     }
-}
\ No newline at end of file
+    std::optional<liblabel::AreaLabel> evaluatePaths(const std::vector<Path>& paths, const liblabel::Aspect aspect, const KPolyWithHoles& ph, const liblabel::Config& config, Workspace& ws, Deadline& deadline, liblabel::LabelStats& stats) {
+        // The boundary segments of ph were collected by constructSkeleton
+        if(config.kernel == liblabel::Config::Kernel::Fast) {
+            auto toFast = [](const KPoint& p) { return FK::Point_2(p.x(), p.y()); };
+            EvaluationGeometry<FK>& fast = ws.fast;
+            fast.boundary.clear();
+            for(const auto& seg : ws.boundary) {
+                fast.boundary.emplace_back(toFast(seg.source()), toFast(seg.target()));
+            }
+            fast.outer.clear();
+            for(auto vit = ph.outer_boundary().vertices_begin(); vit != ph.outer_boundary().vertices_end(); ++vit) {
+                fast.outer.push_back(toFast(*vit));
+            }
+            return evaluatePathsIn(paths, aspect, fast.boundary, fast.outer, fast.candidates, config, ws, deadline, stats);
+        }
+        return evaluatePathsIn(paths, aspect, ws.boundary, ph.outer_boundary(), ws.candidates, config, ws, deadline, stats);
+    }
+}
@@ -0,0 +1,104 @@
+#include <exception>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+#include "liblabeling.h"
+#include "liblabeling_c.h"
+
+struct liblabel_workspace {
+    liblabel::LabelingWorkspace workspace;
+};
+
+namespace {
+    thread_local std::string lastError;
+
+    liblabel_status fail(liblabel_status status, const char* message) {
+        lastError = message;
+        return status;
+    }
+
+    liblabel::Config toConfig(const liblabel_config& c) {
+        liblabel::Config config;
+        config.stepSize = c.step_size;
+        config.numberOfPaths = c.number_of_paths;
+        config.vertexBudget = c.vertex_budget;
+        config.sampling = c.adaptive_sampling ? liblabel::Config::Sampling::Adaptive
+                                              : liblabel::Config::Sampling::Uniform;
+        config.simplifyTolerance = c.simplify_tolerance;
+        config.evaluationThreads = c.evaluation_threads;
+        config.pruneCandidates = c.prune_candidates != 0;
+        config.timeBudget = c.time_budget;
+        config.skeleton = c.segment_voronoi_skeleton ? liblabel::Config::Skeleton::SegmentVoronoi
+                                                     : liblabel::Config::Skeleton::ConformingCDT;
+        config.kernel = c.fast_kernel ? liblabel::Config::Kernel::Fast
+                                      : liblabel::Config::Kernel::ExactPredicates;
+        config.compactSkeleton = c.compact_skeleton != 0;
+        return config;
+    }
+}
+
+void liblabel_default_config(liblabel_config* config) {
+    if(!config) {
+        return;
+    }
+    liblabel::Config d;
+    config->step_size = d.stepSize;
+    config->number_of_paths = d.numberOfPaths;
+    config->vertex_budget = d.vertexBudget;
+    config->adaptive_sampling = d.sampling == liblabel::Config::Sampling::Adaptive;
+    config->simplify_tolerance = d.simplifyTolerance;
+    config->evaluation_threads = d.evaluationThreads;
+    config->prune_candidates = d.pruneCandidates;
+    config->time_budget = d.timeBudget;
+    config->segment_voronoi_skeleton = d.skeleton == liblabel::Config::Skeleton::SegmentVoronoi;
+    config->fast_kernel = d.kernel == liblabel::Config::Kernel::Fast;
+    config->compact_skeleton = d.compactSkeleton;
+}
+
+liblabel_workspace* liblabel_workspace_create(void) {
+    return new(std::nothrow) liblabel_workspace();
+}
+
+void liblabel_workspace_destroy(liblabel_workspace* workspace) {
+    delete workspace;
+}
+
+liblabel_status liblabel_compute_label(double aspect,
+                                       const double* x,
+                                       const double* y,
+                                       size_t stride,
+                                       const size_t* ring_offsets,
+                                       size_t ring_count,
+                                       const liblabel_config* config,
+                                       liblabel_workspace* workspace,
+                                       liblabel_label* label) {
+    lastError.clear();
+    if(!label) {
+        return fail(LIBLABEL_INVALID_ARGUMENT, "label must not be null");
+    }
+
+    try {
+        liblabel::PolygonView view{x, y, stride, ring_offsets, ring_count};
+        liblabel::Config cfg = config ? toConfig(*config) : liblabel::Config();
+        liblabel::LabelStats stats;
+        auto res = workspace ? liblabel::computeLabel(aspect, view, workspace->workspace, false, cfg, &stats)
+                             : liblabel::computeLabel(aspect, view, false, cfg, &stats);
+        if(!res.has_value()) {
+            return stats.partial ? fail(LIBLABEL_NO_LABEL, "time budget exceeded")
+                                 : LIBLABEL_NO_LABEL;
+        }
+        *label = {res->center.x, res->center.y, res->rad_lower, res->rad_upper, res->from, res->to, res->partial};
+        return LIBLABEL_OK;
+    } catch(const std::invalid_argument& e) {
+        return fail(LIBLABEL_INVALID_ARGUMENT, e.what());
+    } catch(const std::exception& e) {
+        return fail(LIBLABEL_ERROR, e.what());
+    } catch(...) {
+        return fail(LIBLABEL_ERROR, "unknown error");
+    }
+}
+
+const char* liblabel_last_error(void) {
+    return lastError.c_str();
+}
@@ -0,0 +1,243 @@
+#ifndef SUBSAMPLING_HPP
+#define SUBSAMPLING_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+#include <vector>
+
+#include "segments_to_graph.hpp"
+
+namespace liblabel {
+namespace detail {
+    using SamplePoint = CDT::Point;
+    using Ring = std::vector<SamplePoint>;
+
+    // Memory reused by the simplification and the feature size estimation
+    struct SamplingBuffers {
+        std::vector<char> keep;
+        std::vector<std::pair<size_t, size_t>> stack;
+        std::vector<std::vector<VH>> vertices;
+        std::vector<std::vector<double>> featureSizes;
+    };
+
+    inline double segLength(const SamplePoint& s, const SamplePoint& t) {
+        return std::sqrt(CGAL::squared_distance(s, t));
+    }
+
+    inline double ringLength(const Ring& ring) {
+        double dist = 0;
+
+        for(size_t i = 0; i < ring.size(); ++i) {
+            dist += segLength(ring[i], ring[(i + 1) % ring.size()]);
+        }
+
+        return dist;
+    }
+
+    // The sample spacing giving the outer ring budget vertices. The holes
+    // are sampled with the same spacing, so they do not count against the
+    // budget.
+    inline double outerSpacing(const std::vector<Ring>& rings, size_t budget) {
+        return rings.empty() ? 0 : ringLength(rings[0]) / std::max<size_t>(budget, 1);
+    }
+
+    // Squared distance of p to the segment a-b, which may be degenerate
+    inline double squaredSegmentDistance(const SamplePoint& p, const SamplePoint& a, const SamplePoint& b) {
+        double dx = b.x() - a.x(), dy = b.y() - a.y();
+        double len = dx*dx + dy*dy;
+        double t = len > 0 ? ((p.x() - a.x())*dx + (p.y() - a.y())*dy) / len : 0;
+        t = std::clamp(t, 0., 1.);
+        double ex = a.x() + t*dx - p.x(), ey = a.y() + t*dy - p.y();
+        return ex*ex + ey*ey;
+    }
+
+    /**
+     * Douglas-Peucker simplification of a closed ring. Every removed vertex
+     * is within tolerance of the simplified ring. Rings which would shrink
+     * to less than 3 vertices are kept as they are.
+     */
+    inline void simplifyRing(Ring& ring, double tolerance, SamplingBuffers& b) {
+        size_t n = ring.size();
+        if(n <= 3 || !(tolerance > 0)) {
+            return;
+        }
+
+        // Split the ring at its first vertex and the vertex furthest from it,
+        // index n refers to the first vertex again
+        size_t far = 0;
+        for(size_t i = 1; i < n; ++i) {
+            if(CGAL::squared_distance(ring[0], ring[i]) > CGAL::squared_distance(ring[0], ring[far])) {
+                far = i;
+            }
+        }
+        b.keep.assign(n, false);
+        b.keep[0] = b.keep[far] = true;
+        b.stack.clear();
+        b.stack.push_back({0, far});
+        b.stack.push_back({far, n});
+
+        double squaredTolerance = tolerance * tolerance;
+        while(!b.stack.empty()) {
+            auto [from, to] = b.stack.back();
+            b.stack.pop_back();
+
+            size_t worst = from;
+            double worstDist = squaredTolerance;
+            for(size_t i = from + 1; i < to; ++i) {
+                double d = squaredSegmentDistance(ring[i], ring[from], ring[to % n]);
+                if(d > worstDist) {
+                    worst = i;
+                    worstDist = d;
+                }
+            }
+            if(worst != from) {
+                b.keep[worst] = true;
+                b.stack.push_back({from, worst});
+                b.stack.push_back({worst, to});
+            }
+        }
+
+        if(std::count(b.keep.begin(), b.keep.end(), true) < 3) {
+            return;
+        }
+        size_t kept = 0;
+        for(size_t i = 0; i < n; ++i) {
+            if(b.keep[i]) {
+                ring[kept++] = ring[i];
+            }
+        }
+        ring.resize(kept);
+    }
+
+    /**
+     * Estimates the local feature size along every ring edge by the smallest
+     * circumradius of the triangles next to it in the constrained Delaunay
+     * triangulation of the rings. The circumcenters are the vertices of the
+     * skeleton, so this is the clearance of the skeleton near the edge.
+     * Edges without such a triangle get an infinite feature size.
+     * cancelled() is polled during the construction of the triangulation,
+     * returns false if it was cancelled.
+     */
+    template <class Cancelled>
+    bool featureSizes(const std::vector<Ring>& rings, SamplingBuffers& b, Cancelled cancelled) {
+        CDT cdt;
+        b.vertices.resize(rings.size());
+        for(size_t r = 0; r < rings.size(); ++r) {
+            auto& vertices = b.vertices[r];
+            vertices.clear();
+            for(const auto& p : rings[r]) {
+                if(vertices.size() % 256 == 0 && cancelled()) {
+                    return false;
+                }
+                vertices.push_back(vertices.empty() ? cdt.insert(p) : cdt.insert(p, vertices.back()->face()));
+            }
+            for(size_t i = 0; i < vertices.size(); ++i) {
+                VH a = vertices[i], c = vertices[(i + 1) % vertices.size()];
+                if(a != c) {
+                    cdt.insert_constraint(a, c);
+                }
+                if(i % 256 == 255 && cancelled()) {
+                    return false;
+                }
+            }
+        }
+
+        const double inf = std::numeric_limits<double>::infinity();
+        b.featureSizes.resize(rings.size());
+        for(size_t r = 0; r < rings.size(); ++r) {
+            const auto& vertices = b.vertices[r];
+            auto& sizes = b.featureSizes[r];
+            sizes.assign(vertices.size(), inf);
+            for(size_t i = 0; i < vertices.size(); ++i) {
+                FH face;
+                int index;
+                VH a = vertices[i], c = vertices[(i + 1) % vertices.size()];
+                if(a == c || !cdt.is_edge(a, c, face, index)) {
+                    continue;
+                }
+                for(FH f : {face, face->neighbor(index)}) {
+                    if(!cdt.is_infinite(f)) {
+                        double r2 = CGAL::squared_distance(cdt.circumcenter(f), f->vertex(0)->point());
+                        sizes[i] = std::min(sizes[i], std::sqrt(r2));
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Computes the sample spacing of every ring edge such that the outer
+     * ring gets about budget samples, the holes are sampled as densely.
+     * Uniform sampling uses the same spacing everywhere. Adaptive sampling
+     * makes the spacing proportional to the local feature size, bounded to
+     * a factor of 8 around the uniform spacing. If it is cancelled while
+     * estimating the feature sizes, the uniform spacing is kept.
+     */
+    template <class Cancelled>
+    void edgeSpacings(const std::vector<Ring>& rings, size_t budget, bool adaptive,
+                      std::vector<std::vector<double>>& spacings, SamplingBuffers& b, Cancelled cancelled) {
+        double uniform = outerSpacing(rings, budget);
+
+        spacings.resize(rings.size());
+        for(size_t r = 0; r < rings.size(); ++r) {
+            spacings[r].assign(rings[r].size(), uniform);
+        }
+        if(!adaptive || !(uniform > 0)) {
+            return;
+        }
+
+        if(!featureSizes(rings, b, cancelled)) {
+            return;
+        }
+        const Ring& outer = rings[0];
+        double weight = 0;
+        for(size_t i = 0; i < outer.size(); ++i) {
+            double lfs = b.featureSizes[0][i];
+            if(std::isfinite(lfs) && lfs > 0) {
+                weight += segLength(outer[i], outer[(i + 1) % outer.size()]) / lfs;
+            }
+        }
+        if(!(weight > 0)) {
+            return;
+        }
+
+        double scale = weight / std::max<size_t>(budget, 1);
+        for(size_t r = 0; r < rings.size(); ++r) {
+            for(size_t i = 0; i < rings[r].size(); ++i) {
+                spacings[r][i] = std::clamp(scale * b.featureSizes[r][i], uniform / 8, uniform * 8);
+            }
+        }
+    }
+
+    // Appends the source of the segment s-t and the points inserted between
+    // s and t, the target is the source of the next segment of the ring.
+    // Zero length segments are skipped.
+    inline void supsampleSegment(const SamplePoint& s, const SamplePoint& t, double precision, std::vector<SamplePoint>& res) {
+        double dist = segLength(s, t);
+        if(!(dist > 0)) {
+            return;
+        }
+        size_t target = precision > 0 ? (size_t) ceil(dist / precision) - 1 : 0; // nr of points to insert
+
+        double stepX = (t.x() - s.x()) / (target + 1);
+        double stepY = (t.y() - s.y()) / (target + 1);
+
+        res.emplace_back(s);
+        for (size_t i = 1; i <= target; ++i) {
+            res.emplace_back(s.x() + i*stepX, s.y() + i*stepY);
+        }
+    }
+
+    inline void supsampleRing(const Ring& ring, const std::vector<double>& spacings, std::vector<SamplePoint>& res) {
+        res.clear();
+        for(size_t i = 0; i < ring.size(); ++i) {
+            supsampleSegment(ring[i], ring[(i + 1) % ring.size()], spacings[i], res);
+        }
+    }
+}
+}
+
+#endif /* SUBSAMPLING_HPP */
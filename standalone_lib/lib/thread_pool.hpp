@@ -0,0 +1,141 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace liblabel {
+namespace detail {
+    /**
+     * Maps a requested number of threads to the number actually used.
+     * A request of 0 means "one thread per hardware core".
+     */
+    inline size_t resolveThreadCount(size_t requested) {
+        if(requested > 0) {
+            return requested;
+        }
+        return std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+
+    /**
+     * A fixed set of background workers executing submitted tasks in FIFO
+     * order. The pool is joined on destruction after the queue drained.
+     */
+    class ThreadPool {
+    public:
+        explicit ThreadPool(size_t workers) {
+            for(size_t i = 0; i < workers; ++i) {
+                threads.emplace_back([this]() { work(); });
+            }
+        }
+
+        ~ThreadPool() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_all();
+            for(auto& t : threads) {
+                t.join();
+            }
+        }
+
+        ThreadPool(const ThreadPool&) = delete;
+        ThreadPool& operator=(const ThreadPool&) = delete;
+
+        // Number of background workers (not counting the calling thread)
+        size_t size() const { return threads.size(); }
+
+        void submit(std::function<void()> task) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                tasks.push_back(std::move(task));
+            }
+            wakeup.notify_one();
+        }
+
+        /**
+         * Calls fn(i) for every i in [0, count) and blocks until all calls
+         * returned. Indices are handed out dynamically, so uneven task sizes
+         * balance themselves. The calling thread takes part in the work.
+         * If fn accepts a second argument it is passed the number of the
+         * executing thread in [0, size()], e.g. to pick per thread buffers.
+         * The first exception thrown by fn is rethrown here.
+         */
+        template <class F>
+        void parallelFor(size_t count, F&& fn) {
+            std::atomic<size_t> next{0};
+            std::exception_ptr error;
+            std::mutex errorMutex;
+
+            auto run = [&](size_t worker) {
+                for(size_t i = next++; i < count; i = next++) {
+                    try {
+                        if constexpr (std::is_invocable_v<F&, size_t, size_t>) {
+                            fn(i, worker);
+                        } else {
+                            fn(i);
+                        }
+                    } catch(...) {
+                        std::lock_guard<std::mutex> lock(errorMutex);
+                        if(!error) error = std::current_exception();
+                    }
+                }
+            };
+
+            size_t helpers = std::min(size(), count > 0 ? count - 1 : 0);
+            size_t pending = helpers;
+            std::mutex doneMutex;
+            std::condition_variable done;
+            for(size_t h = 0; h < helpers; ++h) {
+                submit([&, h]() {
+                    run(h + 1);
+                    std::lock_guard<std::mutex> lock(doneMutex);
+                    if(--pending == 0) done.notify_one();
+                });
+            }
+            run(0);
+
+            std::unique_lock<std::mutex> lock(doneMutex);
+            done.wait(lock, [&]() { return pending == 0; });
+            if(error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+    private:
+        void work() {
+            for(;;) {
+                std::function<void()> task;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wakeup.wait(lock, [this]() { return stopping || !tasks.empty(); });
+                    if(tasks.empty()) {
+                        return;
+                    }
+                    task = std::move(tasks.front());
+                    tasks.pop_front();
+                }
+                task();
+            }
+        }
+
+        std::vector<std::thread> threads;
+        std::deque<std::function<void()>> tasks;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        bool stopping = false;
+    };
+}
+}
+
+#endif /* THREAD_POOL_HPP */
@@ -0,0 +1,158 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "liblabeling.h"
+
+#include "corpus.hpp"
+
+using std::cout;
+using std::endl;
+
+// Counts every heap allocation of the process, including the library's
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size) {
+    ++allocations;
+    if(void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+    size_t vertexCount(const liblabel::Polygon& poly) {
+        size_t count = poly.outer.points.size();
+        for(const auto& hole : poly.holes) {
+            count += hole.points.size();
+        }
+        return count;
+    }
+
+    // The same ring with the midpoint of every edge inserted
+    liblabel::Polyline refine(const liblabel::Polyline& ring) {
+        liblabel::Polyline res;
+        for(size_t i = 0; i < ring.points.size(); ++i) {
+            const auto& p = ring.points[i];
+            const auto& q = ring.points[(i + 1) % ring.points.size()];
+            res.points.push_back(p);
+            res.points.push_back({(p.x + q.x) / 2, (p.y + q.y) / 2});
+        }
+        return res;
+    }
+
+    liblabel::Polygon refine(const liblabel::Polygon& poly) {
+        liblabel::Polygon res;
+        res.outer = refine(poly.outer);
+        for(const auto& hole : poly.holes) {
+            res.holes.push_back(refine(hole));
+        }
+        return res;
+    }
+
+    size_t labelAll(const std::vector<liblabel::Polygon>& polygons, liblabel::LabelingWorkspace* workspace) {
+        size_t before = allocations;
+        for(const auto& poly : polygons) {
+            if(workspace) {
+                liblabel::computeLabel(0.2, poly, *workspace);
+            } else {
+                liblabel::computeLabel(0.2, poly);
+            }
+        }
+        return allocations - before;
+    }
+}
+
+/**
+ * Labels the same polygons with the vertex count doubled three times.
+ * Fails if labeling with a warm workspace allocates more than perLabel times
+ * per polygon, if the allocations per polygon grow by more than growth when
+ * the vertex count doubles, if the workspace does not save allocations over
+ * labeling without one, or if the allocations still grow once the
+ * workspace is warm.
+ *
+ * usage: labeling_allocations_test perLabel growth
+ */
+int main(int argc, char** argv) {
+    if(argc < 3) {
+        std::cerr << "usage: " << argv[0] << " perLabel growth" << endl;
+        return 2;
+    }
+    double perLabel = std::stod(argv[1]);
+    double growth = std::stod(argv[2]);
+
+    std::mt19937 rng(11);
+    std::vector<std::vector<liblabel::Polygon>> levels(1);
+    for(int i = 0; i < 4; ++i) {
+        levels[0].push_back(bench::syntheticPolygon(200, rng));
+    }
+    while(levels.size() < 4) {
+        std::vector<liblabel::Polygon> refined;
+        for(const auto& poly : levels.back()) {
+            refined.push_back(refine(poly));
+        }
+        levels.push_back(std::move(refined));
+    }
+    std::vector<liblabel::Polygon> all;
+    for(const auto& level : levels) {
+        all.insert(all.end(), level.begin(), level.end());
+    }
+
+    size_t fresh = labelAll(all, nullptr);
+
+    liblabel::LabelingWorkspace workspace;
+    labelAll(all, &workspace);
+    std::vector<double> perLevel;
+    size_t warm = 0;
+    for(const auto& level : levels) {
+        size_t count = labelAll(level, &workspace);
+        warm += count;
+        perLevel.push_back(double(count) / level.size());
+    }
+    size_t again = labelAll(all, &workspace);
+
+    cout << "Allocations for " << all.size() << " labels\n"
+         << "without workspace:\t" << fresh << "\n"
+         << "with warm workspace:\t" << warm << ", again " << again << "\n";
+    for(size_t i = 0; i < levels.size(); ++i) {
+        size_t vertices = 0;
+        for(const auto& poly : levels[i]) {
+            vertices += vertexCount(poly);
+        }
+        cout << "per label at " << vertices / levels[i].size() << " vertices:\t" << perLevel[i] << "\n";
+    }
+    cout << "bound:\t\t\t" << perLabel << ", growth " << growth << endl;
+
+    int failures = 0;
+    if(warm >= fresh) {
+        std::cerr << "The warm workspace saves no allocations" << endl;
+        ++failures;
+    }
+    if(again > warm) {
+        std::cerr << "The allocations grow with a warm workspace" << endl;
+        ++failures;
+    }
+    for(size_t i = 0; i < perLevel.size(); ++i) {
+        if(perLevel[i] > perLabel) {
+            std::cerr << "The allocations per label exceed the bound" << endl;
+            ++failures;
+        }
+        if(i > 0 && perLevel[i] > perLevel[i - 1] + growth) {
+            std::cerr << "The allocations per label grow with the vertex count" << endl;
+            ++failures;
+        }
+    }
+    return failures > 0 ? 1 : 0;
+}
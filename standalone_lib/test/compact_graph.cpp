@@ -0,0 +1,183 @@
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include "compact_graph.hpp"
+
+using std::cout;
+using std::endl;
+
+namespace {
+    using Arc = std::pair<std::pair<double, double>, std::pair<double, double>>;
+
+    // Skeleton-like graphs: branch points joined along a random tree, every
+    // edge subdivided into a chain, with short narrow spurs at the branch
+    // points. Some graphs get extra chains between branch points (cycles)
+    // and a separate ring without any branch vertex.
+    struct SkeletonGraph {
+        std::vector<longest_paths::Point> points;
+        std::vector<longest_paths::Segment> edges;
+        std::mt19937& rng;
+        std::uniform_real_distribution<double> unit{0, 1};
+
+        explicit SkeletonGraph(std::mt19937& rng) : rng(rng) {}
+
+        size_t point(double x, double y) {
+            points.push_back({x, y});
+            return points.size() - 1;
+        }
+
+        void edge(size_t a, size_t b, double capacity) {
+            const auto &p = points[a], &q = points[b];
+            double weight = (p.x - q.x) * (p.x - q.x) + (p.y - q.y) * (p.y - q.y);
+            edges.push_back({p, q, weight, capacity, a, b});
+        }
+
+        // A chain of k edges from a to b with capacities around capacity
+        void chain(size_t a, size_t b, size_t k, double capacity) {
+            size_t previous = a;
+            for(size_t i = 1; i < k; ++i) {
+                double t = double(i) / k;
+                size_t inner = point(points[a].x * (1 - t) + points[b].x * t + 0.01 * unit(rng),
+                                     points[a].y * (1 - t) + points[b].y * t);
+                edge(previous, inner, capacity * (0.8 + 0.4 * unit(rng)));
+                previous = inner;
+            }
+            edge(previous, b, capacity * (0.8 + 0.4 * unit(rng)));
+        }
+
+        void generate(size_t i) {
+            size_t branches = 1 + rng() % 10;
+            std::vector<size_t> branch;
+            for(size_t j = 0; j < branches; ++j) {
+                branch.push_back(point(10 * unit(rng), 10 * unit(rng)));
+            }
+            for(size_t j = 1; j < branches; ++j) {
+                chain(branch[rng() % j], branch[j], 1 + rng() % 6, 0.5 + 2 * unit(rng));
+            }
+            if(i % 3 == 0) {
+                for(size_t cycles = rng() % 3; cycles > 0; --cycles) {
+                    size_t a = branch[rng() % branches], b = branch[rng() % branches];
+                    if(a != b) {
+                        chain(a, b, 1 + rng() % 6, 0.5 + 2 * unit(rng));
+                    }
+                }
+            }
+            if(i % 7 == 0) {
+                size_t a = point(20, 20), b = point(21, 20), c = point(21, 21), d = point(20, 21);
+                chain(a, b, 3, 1);
+                chain(b, c, 1, 1);
+                chain(c, d, 2, 1);
+                chain(d, a, 1, 1);
+            }
+            for(size_t j = 0; j < branches; ++j) {
+                for(size_t spurs = rng() % 3; spurs > 0; --spurs) {
+                    const auto& p = points[branch[j]];
+                    size_t leaf = point(p.x + 0.3 * unit(rng), p.y + 0.3 * unit(rng));
+                    chain(branch[j], leaf, 1 + rng() % 2, 0.2 * unit(rng));
+                }
+            }
+        }
+    };
+
+    // Whether points is a walk along the arcs of the graph
+    bool isWalk(const std::set<Arc>& arcs, const std::vector<Node>& points) {
+        for(size_t i = 0; i + 1 < points.size(); ++i) {
+            if(!arcs.count({{points[i].x, points[i].y}, {points[i + 1].x, points[i + 1].y}})) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    double squaredLengths(const std::vector<Node>& points) {
+        double sum = 0;
+        for(size_t i = 0; i + 1 < points.size(); ++i) {
+            double dx = points[i].x - points[i + 1].x, dy = points[i].y - points[i + 1].y;
+            sum += dx * dx + dy * dy;
+        }
+        return sum;
+    }
+}
+
+/**
+ * Checks the compaction of compact_graph.hpp on skeleton-like graphs. Every
+ * edge of the compacted graph and every path found on it has to expand to a
+ * walk of the original graph, and the weight of an edge has to be the sum of
+ * the weights of its chain (the weights are the squared lengths here).
+ *
+ * usage: labeling_compact_graph_test [graphs]
+ */
+int main(int argc, char** argv) {
+    size_t graphs = argc > 1 ? std::stoul(argv[1]) : 3000;
+
+    std::mt19937 rng(7);
+    csr::CsrGraph graph, compacted;
+    csr::Builder builder;
+    csr::Compaction compaction;
+    csr::CompactionBuffers compactionBuffers;
+    csr::SearchBuffers buffers;
+    std::vector<std::vector<Vertex>> paths;
+    std::vector<Node> expanded;
+
+    size_t invalidEdges = 0, wrongWeights = 0, invalidPaths = 0;
+    size_t vertices = 0, compactVertices = 0, spurs = 0;
+    for(size_t i = 0; i < graphs; ++i) {
+        SkeletonGraph skeleton(rng);
+        skeleton.generate(i);
+        csr::from_edges(skeleton.edges, graph, builder);
+        csr::compact(graph, compacted, compaction, compactionBuffers);
+        vertices += graph.num_vertices();
+        compactVertices += compacted.num_vertices();
+        spurs += compaction.pruned_spurs;
+
+        std::set<Arc> arcs;
+        for(Vertex v = 0; v < graph.num_vertices(); ++v) {
+            for(csr::Index a = graph.arc_begin[v]; a < graph.arc_begin[v + 1]; ++a) {
+                const Node &p = graph.nodes[v], &q = graph.nodes[graph.arc_target[a]];
+                arcs.insert({{p.x, p.y}, {q.x, q.y}});
+            }
+        }
+
+        for(Vertex v = 0; v < compacted.num_vertices(); ++v) {
+            for(csr::Index a = compacted.arc_begin[v]; a < compacted.arc_begin[v + 1]; ++a) {
+                Vertex target = compacted.arc_target[a];
+                if(target == v) {
+                    continue;
+                }
+                // expand_path picks the edge with inner vertices among
+                // parallel ones, the weight only matches for that one
+                bool parallel = false;
+                for(csr::Index b = compacted.arc_begin[v]; b < compacted.arc_begin[v + 1]; ++b) {
+                    parallel |= b != a && compacted.arc_target[b] == target;
+                }
+                csr::expand_path(compacted, compaction, {v, target}, expanded);
+                if(!isWalk(arcs, expanded)) {
+                    ++invalidEdges;
+                }
+                double sum = squaredLengths(expanded);
+                if(!parallel && std::abs(sum - compacted.arc_weight[a]) > 1e-9 * (1 + sum)) {
+                    ++wrongWeights;
+                }
+            }
+        }
+
+        csr::find_distinct_paths(compacted, 0.3, 2., 10, buffers, paths);
+        for(const auto& path : paths) {
+            csr::expand_path(compacted, compaction, path, expanded);
+            if(!isWalk(arcs, expanded)) {
+                ++invalidPaths;
+            }
+        }
+    }
+
+    cout << graphs << " graphs, " << vertices << " vertices compacted to "
+         << compactVertices << ", " << spurs << " spurs pruned" << endl;
+    cout << invalidEdges << " edges and " << invalidPaths
+         << " paths do not expand to walks, " << wrongWeights
+         << " edges with wrong weights" << endl;
+    return invalidEdges + wrongWeights + invalidPaths > 0 ? 1 : 0;
+}
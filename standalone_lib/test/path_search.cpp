@@ -0,0 +1,103 @@
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "csr_graph.hpp"
+
+using std::cout;
+using std::endl;
+
+namespace {
+    struct Case {
+        const char* name;
+        bool forest;            // a forest with a few extra edges
+        bool integerWeights;    // many equally long paths
+    };
+
+    // Random edges on up to 80 vertices. Forests exercise the linear tree
+    // search, the extra edges the components with cycles. Weights are never
+    // zero: without any positive length no path is ever long enough and
+    // the search would not end.
+    std::vector<longest_paths::Segment> randomEdges(const Case& c, std::mt19937& rng) {
+        std::uniform_real_distribution<double> real(0.1, 10);
+        auto weight = [&]() { return c.integerWeights ? double(1 + rng() % 3) : real(rng); };
+        // Few distinct capacities share levels, real ones add an edge per level
+        auto capacity = [&]() { return rng() % 2 ? double(1 + rng() % 4) : real(rng); };
+        auto edge = [&](size_t a, size_t b) -> longest_paths::Segment {
+            return {{double(a), 0}, {double(b), 0}, weight(), capacity(), a, b};
+        };
+
+        std::vector<longest_paths::Segment> edges;
+        size_t n = 2 + rng() % 80;
+        if(c.forest) {
+            for(size_t v = 1; v < n; ++v) {
+                if(rng() % 10 != 0) {
+                    edges.push_back(edge(rng() % v, v));
+                }
+            }
+            for(size_t extra = rng() % 4; extra > 0; --extra) {
+                size_t a = rng() % n, b = rng() % n;
+                if(a != b) {
+                    edges.push_back(edge(a, b));
+                }
+            }
+        } else {
+            for(size_t m = rng() % 120; m > 0; --m) {
+                size_t a = rng() % n, b = rng() % n;
+                if(a != b) {
+                    edges.push_back(edge(a, b));
+                }
+            }
+        }
+        std::shuffle(edges.begin(), edges.end(), rng);
+        return edges;
+    }
+}
+
+/**
+ * Compares the path search on the compressed sparse row graph of
+ * csr_graph.hpp with the one on the adjacency_list of longest_paths.hpp.
+ * Both have to find the same paths and search the same number of capacity
+ * levels on random graphs, for several step sizes and aspects.
+ *
+ * usage: labeling_path_search_test [graphs per case]
+ */
+int main(int argc, char** argv) {
+    size_t graphs = argc > 1 ? std::stoul(argv[1]) : 2000;
+    const Case cases[] = {
+        {"random, real weights", false, false},
+        {"random, integer weights", false, true},
+        {"forest, real weights", true, false},
+        {"forest, integer weights", true, true},
+    };
+
+    std::mt19937 rng(21);
+    Graph graph;
+    GraphBuilder builder;
+    PathSearchBuffers buffers;
+    csr::CsrGraph csrGraph;
+    csr::Builder csrBuilder;
+    csr::SearchBuffers csrBuffers;
+    std::vector<std::vector<Vertex>> expected, paths;
+
+    size_t failures = 0;
+    for(const Case& c : cases) {
+        size_t differing = 0;
+        for(size_t i = 0; i < graphs; ++i) {
+            auto edges = randomEdges(c, rng);
+            double step = i % 3 == 0 ? 2. : i % 3 == 1 ? 1.3 : 1.05;
+            double aspect = 0.05 + (rng() % 100) / 100.;
+            from_edges(edges, graph, builder);
+            csr::from_edges(edges, csrGraph, csrBuilder);
+            size_t levels = find_distinct_paths(graph, aspect, step, 10, buffers, expected);
+            size_t csrLevels = csr::find_distinct_paths(csrGraph, aspect, step, 10, csrBuffers, paths);
+            if(levels != csrLevels || expected != paths) {
+                ++differing;
+            }
+        }
+        cout << c.name << ": " << differing << " of " << graphs << " graphs differ" << endl;
+        failures += differing;
+    }
+    return failures > 0 ? 1 : 0;
+}